@@ -20,7 +20,7 @@ enum background_effect {
 };
 
 // stores data that can be used by background effects
-// song_tick: how long the song has been playing, in milliseconds
+// song_tick: how long the song has been playing, in milliseconds (with sub-millisecond precision)
 // beat_tick: how long the current beat has lasted (this resets to 0 after every beat)
 // beat_advanced: bool flag, true for 1 frame when advancing to the next beat
 // shape_advanced: similar to beat_advanced, but true when moving to the next shape
@@ -29,8 +29,8 @@ enum background_effect {
 // measure_length: how many beats in a measure (default: 16)
 // grid_color: the background color of the grid
 struct bg_data {
-    int song_tick;
-    int beat_tick;
+    float song_tick;
+    float beat_tick;
     bool beat_advanced;
     bool shape_advanced;
     int beat_count;
@@ -0,0 +1,103 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+// audio offset calibration
+// the player taps along to a click track (see start_click_track() in timing.cpp), and each tap is compared to the nearest click
+// the average of those differences is how far behind the song clock the player actually hears (and reacts to) the audio
+// ----------------------------------------------------------
+// calibration_bpm: speed of the click track
+// calibration_tap_target: how many taps to collect before finishing
+// calibration_skip: clicks to let pass before taps start counting, so the player can find the rhythm first
+const int calibration_bpm = 100;
+const int calibration_tap_target = 16;
+const int calibration_skip = 4;
+
+std::vector<double> calibration_taps;
+double calibration_offset = 0;
+double calibration_deviation = 0;
+
+void init_calibration() {
+    calibration_taps.clear();
+    calibration_offset = 0;
+    calibration_deviation = 0;
+    return;
+}
+
+double get_calibration_interval() {
+    // returns the time between clicks, in milliseconds
+    return 60000.0 / calibration_bpm;
+}
+
+bool check_calibration_finished() {
+    return calibration_taps.size() >= calibration_tap_target;
+}
+
+void calibration_tap(double time) {
+    // records a tap; time is when it happened on the song clock
+    if (check_calibration_finished()) {return;}
+
+    double interval = get_calibration_interval();
+    int nearest_click = round(time / interval);
+
+    if (nearest_click < calibration_skip) {return;}
+
+    calibration_taps.push_back(time - nearest_click * interval);
+
+    if (!check_calibration_finished()) {return;}
+
+    // works out the mean offset and how much the taps varied around it
+    double sum = 0;
+    double squares = 0;
+
+    for (int i = 0; i < calibration_taps.size(); i++) {
+        sum += calibration_taps[i];
+        squares += calibration_taps[i] * calibration_taps[i];
+    }
+
+    calibration_offset = sum / calibration_taps.size();
+    calibration_deviation = sqrt(fmax(0, squares / calibration_taps.size() - calibration_offset * calibration_offset));
+
+    printf("Calibration finished: offset is %.1f ms (+/- %.1f ms).\n", calibration_offset, calibration_deviation);
+    return;
+}
+
+int get_calibration_tap_count() {
+    return calibration_taps.size();
+}
+
+int get_calibration_tap_target() {
+    return calibration_tap_target;
+}
+
+double get_calibration_offset() {
+    return calibration_offset;
+}
+
+double get_calibration_deviation() {
+    return calibration_deviation;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+void init_calibration();
+double get_calibration_interval();
+void calibration_tap(double);
+int get_calibration_tap_count();
+int get_calibration_tap_target();
+bool check_calibration_finished();
+double get_calibration_offset();
+double get_calibration_deviation();
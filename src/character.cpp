@@ -23,6 +23,7 @@
 */
 
 #include <cstdlib>
+#include <atomic>
 
 #include <SDL2/SDL.h>
 #include <nlohmann/json.hpp>
@@ -30,7 +31,8 @@
 using nlohmann::json;
 using std::vector;
 
-int character_hold_timer = 0;
+// these are atomic since gameplay (on the simulation thread) sets the character's state while the render thread draws it
+std::atomic<int> character_hold_timer{0};
 SDL_ScaleMode character_scale_mode = SDL_ScaleModeLinear;
 
 struct character_frames {
@@ -61,7 +63,7 @@ enum character_states {
     SCALE_DOWN
 };
 
-character_states current_state = IDLE;
+std::atomic<character_states> current_state{IDLE};
 
 character_frames frames = {
     {{0, 0, 0, 0}},
@@ -0,0 +1,190 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "compositor.h"
+
+// the software compositor: draws shapes into a plain block of RGBA pixels instead of onto a render target
+// every shape is broken down into rows (spans), and each span is filled by writing its color straight into the pixels
+// that replaces whatever was there, alpha and all, which is exactly what "erase" colors need (see draw_shape_layer() in graphics.cpp)
+// spans are filled 8 pixels at a time with AVX2 or 4 at a time with SSE2, whichever the CPU supports; that's checked once, at startup
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_SPAN_FILL
+#include <immintrin.h>
+#endif
+
+typedef void (*span_fill_function)(uint32_t*, int, uint32_t);
+
+void fill_span_scalar(uint32_t *dst, int count, uint32_t value) {
+    for (int i = 0; i < count; i++) {dst[i] = value;}
+    return;
+}
+
+#ifdef SIMD_SPAN_FILL
+__attribute__((target("sse2")))
+void fill_span_sse2(uint32_t *dst, int count, uint32_t value) {
+    __m128i fill = _mm_set1_epi32(value);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {_mm_storeu_si128((__m128i*) (dst + i), fill);}
+    for (; i < count; i++) {dst[i] = value;}
+    return;
+}
+
+__attribute__((target("avx2")))
+void fill_span_avx2(uint32_t *dst, int count, uint32_t value) {
+    __m256i fill = _mm256_set1_epi32(value);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {_mm256_storeu_si256((__m256i*) (dst + i), fill);}
+    for (; i < count; i++) {dst[i] = value;}
+    return;
+}
+#endif
+
+const char *span_fill_name = "scalar";
+
+span_fill_function pick_span_fill() {
+    // picks the widest span fill the CPU can run
+    #ifdef SIMD_SPAN_FILL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {span_fill_name = "AVX2"; return fill_span_avx2;}
+    if (__builtin_cpu_supports("sse2")) {span_fill_name = "SSE2"; return fill_span_sse2;}
+    #endif
+
+    return fill_span_scalar;
+}
+
+span_fill_function fill_span = pick_span_fill();
+
+const char* get_span_fill_name() {
+    return span_fill_name;
+}
+
+uint32_t get_canvas_pixel(const unsigned char rgba[4]) {
+    // returns a color as a canvas pixel; canvases are stored as R, G, B, A bytes in that order, whatever the CPU's byte order is
+    uint32_t pixel;
+    memcpy(&pixel, rgba, 4);
+    return pixel;
+}
+
+void resize_shape_canvas(shape_canvas &canvas, int size) {
+    // sets the canvas to size x size pixels, and clears it
+    canvas.size = size;
+    canvas.pixels.assign(size * size, 0);
+    canvas.dirty_top = 0;
+    canvas.dirty_bottom = size;
+    return;
+}
+
+void clear_shape_canvas(shape_canvas &canvas) {
+    // makes every pixel on the canvas transparent
+    if (canvas.size <= 0) {return;}
+
+    fill_span(canvas.pixels.data(), canvas.pixels.size(), 0);
+    canvas.dirty_top = 0;
+    canvas.dirty_bottom = canvas.size;
+    return;
+}
+
+void mark_shape_canvas_clean(shape_canvas &canvas) {
+    // call once the canvas's changes have been copied wherever they need to go (i.e. uploaded to a texture)
+    canvas.dirty_top = canvas.size;
+    canvas.dirty_bottom = 0;
+    return;
+}
+
+void fill_canvas_row(shape_canvas &canvas, int x, int y, int w, uint32_t pixel) {
+    // fills w pixels of row y, starting at x; anything off the canvas is left out
+    if (y < 0 || y >= canvas.size) {return;}
+
+    if (x < 0) {w += x; x = 0;}
+    if (x + w > canvas.size) {w = canvas.size - x;}
+    if (w <= 0) {return;}
+
+    fill_span(&canvas.pixels[y * canvas.size + x], w, pixel);
+
+    if (y < canvas.dirty_top) {canvas.dirty_top = y;}
+    if (y + 1 > canvas.dirty_bottom) {canvas.dirty_bottom = y + 1;}
+    return;
+}
+
+void fill_canvas_shape(shape_canvas &canvas, const shape &s, const unsigned char rgba[4], float gscale) {
+    // draws a shape onto the canvas, on a grid whose squares are gscale pixels across; see draw_shape() in graphics.cpp for the shape's parameters
+    // shapes are broken into rows the same way SDL draws them as rectangles, so they come out pixel-for-pixel the same as they always have
+    uint32_t pixel = get_canvas_pixel(rgba);
+    int x = gscale * (s.x + 0.5);
+    int y = gscale * (s.y + 0.5);
+    int size = gscale * (1 + 2 * (s.scale-1));
+
+    switch (s.type) {
+        // circle; a row above and below the middle at a time, then the middle row
+        case 0: {
+            int y1, y2;
+            float r = gscale/2 * (1 + 2 * (s.scale-1));
+
+            for (y1 = -r, y2 = r; y1; y1++, y2--) {
+                int xr = (int)(sqrt(r*r - y1*y1) + 0.5);
+
+                fill_canvas_row(canvas, x - xr, y + y1, 2 * xr, pixel);
+                fill_canvas_row(canvas, x - xr, y + y2, 2 * xr, pixel);
+            }
+
+            fill_canvas_row(canvas, x - r, y, 2 * r, pixel);
+            return;
+        }
+
+        // square
+        case 1: {
+            int left = x - (size * 0.5);
+            int top = y - (size * 0.5);
+
+            for (int i = 0; i < size; i++) {fill_canvas_row(canvas, left, top + i, size, pixel);}
+            return;
+        }
+
+        // triangle; each row is half a pixel wider on either side than the one above it
+        case 2: {
+            int y1 = y - (size * 0.5);
+            int y2 = y1 + size;
+
+            for (int y3 = 0; y1 < y2; y1++, y3++) {
+                fill_canvas_row(canvas, (x - (size*0.25)) + ((y-y1) * 0.5), y1, y3, pixel);
+            }
+            return;
+        }
+
+        // none/null
+        case -1:
+        default:
+            return;
+    }
+
+    return;
+}
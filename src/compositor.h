@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "core.h"
+
+// a block of RGBA pixels that shapes can be drawn onto in software (see compositor.cpp)
+// pixels: size * size pixels, row by row; see get_canvas_pixel() for their layout
+// dirty_top/dirty_bottom: the rows that have changed since the canvas was last marked clean (dirty_bottom isn't included); none have if dirty_top >= dirty_bottom
+struct shape_canvas {
+    int size = 0;
+    std::vector<uint32_t> pixels;
+    int dirty_top = 0;
+    int dirty_bottom = 0;
+};
+
+const char* get_span_fill_name();
+uint32_t get_canvas_pixel(const unsigned char[4]);
+void resize_shape_canvas(shape_canvas&, int);
+void clear_shape_canvas(shape_canvas&);
+void mark_shape_canvas_clean(shape_canvas&);
+void fill_canvas_shape(shape_canvas&, const shape&, const unsigned char[4], float);
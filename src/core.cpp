@@ -0,0 +1,664 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core.h"
+
+// nothing in here should depend on SDL (or anything else in the game); it gets built into its own library (see Makefile)
+// all of this is deterministic: the same schedule, times, and inputs always give the same state and events
+
+using std::string;
+using std::vector;
+
+// enables extra logging; set by the game when debug mode is on
+bool core_debug = false;
+
+void set_core_debug(bool enabled) {
+    core_debug = enabled;
+    return;
+}
+
+void compile_beat_flags(level_schedule &schedule) {
+    // fills in schedule.beat_flags from the measure length; a cycle is one CPU phase followed by one player phase
+    int measure_length = schedule.measure_length;
+    schedule.beat_flags.assign(measure_length * 2, 0);
+
+    for (int i = 0; i < measure_length * 2; i++) {
+        if (i == 0) {schedule.beat_flags[i] |= BEAT_SHAPE_START;}
+        if (i % measure_length == 0) {schedule.beat_flags[i] |= BEAT_PHASE_SWAP;}
+        if (i >= measure_length) {schedule.beat_flags[i] |= BEAT_PLAYER;}
+    }
+
+    return;
+}
+
+shape apply_shape_op(char opcode, shape current_shape) {
+    // modifies the shape passed into it using an "opcode"
+    // if the shape is invisible (type -1), only the ops that create a shape do anything
+    // ----------------------------------------------------------
+    // opcode: single letter that represents an action (corresponding to keyboard controls)
+    // shape: the shape parameters to modify
+
+    shape modified_shape = current_shape;
+
+    // check to see if the shape is visible
+    if (modified_shape.type == -1) {
+        // check to see if the opcode isnt one that makes said shape visible
+        if (opcode != 'Z' && opcode != 'X' && opcode != 'C') return modified_shape;
+    }
+
+    switch (opcode) {
+        // circle
+        case 'Z':
+            modified_shape.type = 0;
+            modified_shape.x = 7;
+            modified_shape.y = 7;
+            modified_shape.scale = 1;
+            break;
+
+        // square
+        case 'X':
+            modified_shape.type = 1;
+            modified_shape.x = 7;
+            modified_shape.y = 7;
+            modified_shape.scale = 1;
+            break;
+
+        // triangle
+        case 'C':
+            modified_shape.type = 2;
+            modified_shape.x = 7;
+            modified_shape.y = 7;
+            modified_shape.scale = 1;
+            break;
+
+        // shrink
+        case 'A':
+            if (modified_shape.scale > 1) {modified_shape.scale--;}
+            break;
+
+        // grow
+        case 'S':
+            if (modified_shape.scale < 8) {modified_shape.scale++;}
+            break;
+
+        // up
+        case 'U':
+            if (modified_shape.y > 0) {modified_shape.y--;}
+            break;
+
+        // down
+        case 'D':
+            if (modified_shape.y < 14) {modified_shape.y++;}
+            break;
+
+        // left
+        case 'L':
+            if (modified_shape.x > 0) {modified_shape.x--;}
+            break;
+
+        // right
+        case 'R':
+            if (modified_shape.x < 14) {modified_shape.x++;}
+            break;
+
+        // x-plode (essentially a NOP) and no-op
+        case 'V':
+        case '.':
+            break;
+
+        default: break;
+    }
+
+    return modified_shape;
+}
+
+bool compare_shapes(shape shape_1, shape shape_2) {
+    // returns true if the player and CPU shapes match properties
+
+    if (shape_1.x != shape_2.x) return false;
+    if (shape_1.y != shape_2.y) return false;
+    if (shape_1.type != shape_2.type) return false;
+    if (shape_1.scale != shape_2.scale) return false;
+
+    return true;
+}
+
+bool check_sequence_validity(const string &sequence, shape shape_result) {
+    // checks to see if a given sequence actually becomes the shape it corresponds to
+    // used in parse_level_file()
+
+    // runs the sequence on a blank shape, packed (see get_shape_state()) since this is done for every shape in every level
+    packed_shape shape_test = run_packed_sequence(sequence, 0);
+
+    if (core_debug) {
+        shape test = get_state_shape(shape_test);
+        printf("shape_test: %i %i %i %i \nexpected: %i %i %i %i \n", test.type, test.x, test.y, test.scale, shape_result.type, shape_result.x, shape_result.y, shape_result.scale);
+    }
+
+    return shape_test == get_shape_state(shape_result);
+}
+
+// packed shapes
+// every shape the player can make is one of shape_state_count states: the blank shape they start each measure with (0), or a visible shape
+// a shape packed down to its state can have ops run on it with a single table lookup, with no branching on the op and nothing else touched,
+// which is what check_sequence_validity() and the solver use; apply_shape_op() is still the reference for what each op does
+// ----------------------------------------------------------
+// packed_ops: every op that does something; the table has one column for each, in this order
+constexpr char packed_ops[] = "ZXCSARLDU";
+constexpr int packed_op_count = 9;
+
+struct packed_op_table {
+    unsigned short next[shape_state_count][packed_op_count];
+    signed char op_index[256];   // the column for each op, or -1 for ops that do nothing (x-plode, no-op, anything unknown)
+};
+
+constexpr int pack_shape(int type, int x, int y, int scale) {
+    return 1 + ((type * 8 + (scale - 1)) * 15 + y) * 15 + x;
+}
+
+constexpr packed_op_table build_packed_op_table() {
+    // works out what every op does to every state; this follows apply_shape_op() exactly (core_test checks that it does)
+    packed_op_table table = {};
+
+    for (int i = 0; i < 256; i++) {table.op_index[i] = -1;}
+    for (int i = 0; i < packed_op_count; i++) {table.op_index[(unsigned char) packed_ops[i]] = i;}
+
+    for (int state = 0; state < shape_state_count; state++) {
+        int type = -1;
+        int x = 7;
+        int y = 7;
+        int scale = 1;
+
+        if (state > 0) {
+            x = (state - 1) % 15;
+            y = (state - 1) / 15 % 15;
+            scale = (state - 1) / (15 * 15) % 8 + 1;
+            type = (state - 1) / (15 * 15 * 8);
+        }
+
+        for (int i = 0; i < packed_op_count; i++) {
+            char op = packed_ops[i];
+            int next = state;
+
+            if (op == 'Z' || op == 'X' || op == 'C') {
+                next = pack_shape(i, 7, 7, 1); // the shape ops come first, so i is the shape type
+            } else if (type != -1) {
+                if (op == 'A' && scale > 1) {next = pack_shape(type, x, y, scale - 1);}
+                if (op == 'S' && scale < 8) {next = pack_shape(type, x, y, scale + 1);}
+                if (op == 'U' && y > 0) {next = pack_shape(type, x, y - 1, scale);}
+                if (op == 'D' && y < 14) {next = pack_shape(type, x, y + 1, scale);}
+                if (op == 'L' && x > 0) {next = pack_shape(type, x - 1, y, scale);}
+                if (op == 'R' && x < 14) {next = pack_shape(type, x + 1, y, scale);}
+            }
+
+            table.next[state][i] = next;
+        }
+    }
+
+    return table;
+}
+
+constexpr packed_op_table packed_op_table_data = build_packed_op_table();
+
+int get_shape_state(shape target) {
+    // returns the state a shape packs down to, or -1 if it's not one the player can make (e.g. out of bounds)
+    // the color isn't part of the state, so it's ignored
+    if (target.type == -1) {
+        return (target.x == 7 && target.y == 7 && target.scale == 1) ? 0 : -1;
+    }
+
+    if (target.type < 0 || target.type > 2) {return -1;}
+    if (target.x < 0 || target.x > 14 || target.y < 0 || target.y > 14) {return -1;}
+    if (target.scale < 1 || target.scale > 8) {return -1;}
+
+    return pack_shape(target.type, target.x, target.y, target.scale);
+}
+
+shape get_state_shape(int state) {
+    // the opposite of get_shape_state(); the color's always 0
+    if (state == 0) {return {-1, 7, 7, 1, 0};}
+
+    state--;
+    int x = state % 15;
+    int y = (state / 15) % 15;
+    int scale = (state / (15 * 15)) % 8 + 1;
+    int type = state / (15 * 15 * 8);
+
+    return {type, x, y, scale, 0};
+}
+
+packed_shape apply_packed_op(char opcode, packed_shape state) {
+    // apply_shape_op() for a packed shape
+    int op = packed_op_table_data.op_index[(unsigned char) opcode];
+    if (op == -1) {return state;}
+
+    return packed_op_table_data.next[state][op];
+}
+
+packed_shape run_packed_sequence(const string &sequence, packed_shape state) {
+    // runs a whole sequence on a packed shape, returning the shape it ends up as
+    for (int i = 0; i < sequence.length(); i++) {
+        state = apply_packed_op(sequence[i], state);
+    }
+
+    return state;
+}
+
+// the shape solver
+// the shortest way to reach every state from the blank shape is worked out once, with a breadth-first search over the packed op table
+// after that, the fewest ops needed for any shape, and a sequence that makes it, are just a lookup
+// when there's more than one shortest sequence, ops are preferred in packed_ops order, which gives the same sequences levels have
+// always had generated for them (shape, then scale, then horizontal, then vertical)
+
+struct shape_solver {
+    vector<int> distance;       // fewest ops to reach each state, or -1 if it can't be reached
+    vector<int> previous;       // the state each state is reached from on its shortest path
+    vector<char> previous_op;   // the op that does it
+};
+
+shape_solver build_shape_solver() {
+    // searches the packed op table outwards from the blank shape
+    shape_solver solver;
+    solver.distance.assign(shape_state_count, -1);
+    solver.previous.assign(shape_state_count, -1);
+    solver.previous_op.assign(shape_state_count, '.');
+
+    vector<int> queue;
+    queue.reserve(shape_state_count);
+    queue.push_back(0);
+    solver.distance[0] = 0;
+
+    for (int i = 0; i < queue.size(); i++) {
+        int state = queue[i];
+
+        for (int j = 0; j < packed_op_count; j++) {
+            int next = packed_op_table_data.next[state][j];
+            if (solver.distance[next] != -1) {continue;}
+
+            solver.distance[next] = solver.distance[state] + 1;
+            solver.previous[next] = state;
+            solver.previous_op[next] = packed_ops[j];
+            queue.push_back(next);
+        }
+    }
+
+    return solver;
+}
+
+const shape_solver& get_shape_solver() {
+    // built the first time it's needed; levels are parsed on more than one thread, which a static handles safely
+    static const shape_solver solver = build_shape_solver();
+    return solver;
+}
+
+int get_shape_distance(shape target) {
+    // returns the fewest ops needed to make a shape from the blank shape, or -1 if it can't be made at all
+    int state = get_shape_state(target);
+    if (state == -1) {return -1;}
+
+    return get_shape_solver().distance[state];
+}
+
+string solve_shape_sequence(shape target) {
+    // returns a shortest sequence that makes a shape from the blank shape (without any padding)
+    // returns an empty string if it can't be made at all; check get_shape_distance() first to tell that apart from the blank shape
+    int state = get_shape_state(target);
+    if (state == -1) {return "";}
+
+    const shape_solver &solver = get_shape_solver();
+    string sequence(solver.distance[state], '.');
+
+    for (int i = sequence.length() - 1; i >= 0; i--) {
+        sequence[i] = solver.previous_op[state];
+        state = solver.previous[state];
+    }
+
+    return sequence;
+}
+
+int calculate_score(const string &cpu_sequence, const string &player_sequence) {
+    // calculates a score to give the player by comparing sequence strings
+    // ----------------------------------------------------------
+    // SCORE TABLE IS: 100 for any ops that match CPU (except blanks), 50 for new ops, 25 for new xplodes
+    int score = 0;
+
+    if (core_debug) {
+        printf("CPU: %s\nPLY: %s\n", cpu_sequence.c_str(), player_sequence.c_str());
+    }
+
+    for (int i = 0; i < player_sequence.length(); i++) {
+        char cpu_op = cpu_sequence[i];
+        char player_op = player_sequence[i];
+
+        if (cpu_op == '.') {
+            if (player_op == '.') {continue;}
+            if (player_op == 'X') {score += 25; continue;}
+            score += 50;
+        }
+
+        // if we're at this point in the loop, then we know that:
+        // score is 50, cpu_op isn't blank, player_op also isn't blank or an xplode
+
+        if (cpu_op == player_op) {score += 50; continue;}
+    }
+
+    return score;
+}
+
+int check_beat_timing_window(const core_state &state, const level_schedule &schedule, double current_time) {
+    // returns 0 if we're not within the beat, 1 on the "left side" (beat end), 2 on the right side (beat start)
+    // the window should be within ~120 ms, or 60ms on each "side" of a beat (roughly equivalent to a "Good" in DDR)
+    // current_time: time of the input on the song clock
+
+    double current_beat_length = (current_time - state.beat_start_time);
+    double time_to_next_beat = state.beat_length - current_beat_length;
+    int measure_length = schedule.measure_length;
+    int start_offset = schedule.start_offset;
+    int beat_count = state.beat_count;
+    bool valid_beat_window_start = false;
+    bool valid_beat_window_end = false;
+
+    // this statement excludes all of the intro
+    if (state.intro_length >= current_time) {return 0;}
+
+    // and this excludes the end of the song
+    if (state.song_over) {return 0;}
+
+    // this excludes beats where the CPU is in control, as well as parts of beats that shouldnt be 'allowed'
+    // this means that there's not measure_length of valid beats, but rather measure_length of windows
+    if ((beat_count - start_offset)%(measure_length*2) >= measure_length) {valid_beat_window_start = true;}
+    if (((beat_count - start_offset) - 1)%(measure_length*2) >= measure_length) {valid_beat_window_end = true;}
+
+    // finally, checks the timing window
+    // both sides are bounded, so a press is only ever judged against the beat it's actually near
+    if (valid_beat_window_end && current_beat_length >= -60 && current_beat_length <= 60) {return 1;}
+    if (valid_beat_window_start && time_to_next_beat >= -60 && time_to_next_beat <= 60) {return 2;}
+
+    return 0;
+}
+
+int get_sequence_index(const core_state &state, const level_schedule &schedule, int beat_side) {
+    // returns which op in the player's sequence an input on the given side of a beat is recorded to
+    // ----------------------------------------------------------
+    // beat_side: returned from check_beat_timing_window(); 1 = beat end, 2 = beat start
+    int measure_length = schedule.measure_length;
+    int current_beat_count = (state.beat_count - schedule.start_offset) % measure_length;
+    int index = 0;
+
+    if (beat_side == 1) {index = current_beat_count - 1;}
+    if (beat_side == 2) {index = current_beat_count;}
+
+    if (index <= 0) {index = 0;}
+    if (index >= measure_length) {index = measure_length - 1;}
+
+    return index;
+}
+
+void reset_shapes(core_state &state) {
+    // resets shapes to default values
+    state.result_shape = {0, 7, 7, 1, 0};
+    state.active_shape = {-1, 7, 7, 1, 0}; // this makes the shape render invisible by default
+    return;
+}
+
+void reset_sequences(core_state &state, const level_schedule &schedule) {
+    // resets sequences to blank strings
+    state.cpu_sequence.assign(schedule.measure_length, '.');
+    state.player_sequence.assign(schedule.measure_length, '.');
+    return;
+}
+
+void modify_life(core_state &state, int mod) {
+    // adds or subtracts life value; wrapped up to ensure it's capped consistently
+    state.life += mod;
+
+    if (state.life < 0) {state.life = 0;}
+    if (state.life > 100) {state.life = 100;}
+    return;
+}
+
+void judge_input(core_state &state, const level_schedule &schedule, const core_input &input, vector<core_event> &events) {
+    // judges a single in-game input and applies it to the player's shape and sequence
+
+    if (state.game_over) {return;}
+
+    int beat_side = check_beat_timing_window(state, schedule, input.time);
+
+    // 0 means we're NOT within a timing window
+    if (beat_side == 0) {return;}
+
+    // this prevents multiple inputs from going through during a single window (e.g. "diagonals")
+    // it also means a sequence can't be overwritten
+    int index = get_sequence_index(state, schedule, beat_side);
+    if (state.player_sequence[index] != '.') {return;}
+
+    state.active_shape = apply_shape_op(input.op, state.active_shape);
+    state.player_sequence[index] = input.op;
+
+    // ops only take effect on a visible shape (see apply_shape_op())
+    events.push_back({CORE_PLAYER_OP, input.op, state.active_shape.type != -1});
+    return;
+}
+
+void process_beat(core_state &state, const level_schedule &schedule, vector<core_event> &events) {
+    // advances the game by exactly one beat; called for every beat that has elapsed
+    int start_offset = schedule.start_offset;
+    int measure_length = schedule.measure_length;
+    int shape_count = (state.beat_count - start_offset)/(measure_length*2);
+
+    events.push_back({CORE_BEAT, '.', state.beat_count});
+
+    // waits until the song's reached past the intro
+    if (state.song_over == false && state.beat_count >= start_offset) {
+        unsigned char flags = schedule.beat_flags[(state.beat_count - start_offset)%(measure_length*2)];
+
+        // triggers at the start of every shape (a.k.a, the start of every CPU/player phase)
+        if (flags & BEAT_SHAPE_START) {
+            if (state.beat_count == start_offset) {
+                state.song_beat_position = state.beat_count;
+            } else {
+                int song_step_amount = (shape_count <= schedule.total_shapes) ? schedule.song_steps[shape_count] : measure_length*2;
+
+                if (compare_shapes(state.active_shape, state.result_shape) == true) {
+                    // reward player with life and points
+                    modify_life(state, 5);
+                    state.combo++;
+                    state.score += (calculate_score(state.cpu_sequence, state.player_sequence) * state.combo);
+                    events.push_back({CORE_SHAPE_CLEARED, '.', shape_count});
+
+                    // triggers the combo effect when reaching multiples of 5
+                    if (state.combo%5 == 0) {events.push_back({CORE_COMBO, '.', state.combo});}
+
+                    // advances the song
+                    state.song_beat_position += song_step_amount;
+                    events.push_back({CORE_SEEK, '.', state.song_beat_position});
+
+                    // pushes shapes to vector for drawing
+                    state.active_shape.color = schedule.colors[shape_count];
+                    state.previous_shapes.push_back(state.active_shape);
+
+                    // pushes auto_shapes as well, if present
+                    int first_auto_shape = schedule.auto_shape_start[shape_count];
+                    int last_auto_shape = schedule.auto_shape_start[shape_count + 1];
+
+                    if (first_auto_shape < last_auto_shape) {
+                        if (core_debug) {printf("Pushing auto-shapes to shape draw queue...\n");}
+                        state.previous_shapes.insert(state.previous_shapes.end(), schedule.auto_shapes.begin() + first_auto_shape, schedule.auto_shapes.begin() + last_auto_shape);
+                    }
+                } else {
+                    // resets the song back to where it goes
+                    events.push_back({CORE_SHAPE_FAILED, '.', shape_count});
+                    events.push_back({CORE_SEEK, '.', state.song_beat_position});
+                    state.beat_count -= measure_length*2;
+
+                    // re-calculates shape_count for cpu_sequence below
+                    shape_count = (state.beat_count - start_offset)/(measure_length*2);
+
+                    // penalize player's life and combo
+                    modify_life(state, -25);
+                    state.combo = 0;
+                }
+            }
+
+            // are we dead yet?
+            if (state.life == 0) {
+                state.game_over = true;
+                events.push_back({CORE_GAME_OVER, '.', 0});
+            }
+
+            reset_shapes(state);
+            reset_sequences(state, schedule);
+            int next_shape = (shape_count + 1 < schedule.total_shapes) ? shape_count + 1 : schedule.total_shapes;
+            state.cpu_sequence.assign(&schedule.cpu_ops[next_shape * measure_length], measure_length);
+        }
+
+        // triggers at the start of every swap between CPU and player
+        if (flags & BEAT_PHASE_SWAP) {
+            events.push_back({CORE_PHASE_SWAP, '.', 0});
+        }
+
+        // triggers for every beat where the player has control
+        if (flags & BEAT_PLAYER) {
+            if (state.beat_count%2 == 0) {events.push_back({CORE_RUMBLE, '.', 0});}
+        }
+
+        // triggers for every beat where the CPU has control
+        if (!(flags & BEAT_PLAYER)) {
+            int string_index = ((state.beat_count - start_offset)/(measure_length*2)) + 1;
+
+            // also checks to make sure the game isn't over
+            if (string_index <= schedule.total_shapes && state.game_over == false) {
+                // gets current position in sequence, performs action on shape
+                int index = (state.beat_count - start_offset) % measure_length;
+                char op = schedule.cpu_ops[string_index * measure_length + index];
+
+                state.result_shape = apply_shape_op(op, state.result_shape);
+                if (state.result_shape.type != -1) {events.push_back({CORE_CPU_OP, op, 0});}
+            }
+        }
+    }
+
+    state.beat_count++;
+    state.beat_start_time += state.beat_length;
+
+    return;
+}
+
+void check_level_end(core_state &state, const level_schedule &schedule, vector<core_event> &events) {
+    // checks whether the last shape has been placed, and ends the level a few beats afterwards
+    // this basically just says "give us 0 if it's negative, otherwise give us how many shapes have passed"
+    // this gets offset by 1 since element 0 in level.json is a header
+    int start_offset = schedule.start_offset;
+    int measure_length = schedule.measure_length;
+    int shape_count = ((state.beat_count - start_offset) < 0) ? 0: (state.beat_count - (start_offset + 1))/(measure_length*2) + 1;
+
+    if (shape_count > schedule.total_shapes) {
+        if (state.song_over == false) {
+            state.song_over = true;
+            events.push_back({CORE_SONG_OVER, '.', 0});
+        }
+
+        if (shape_count >= schedule.total_shapes + 3 && state.level_finished == false) {
+            state.level_finished = true;
+            events.push_back({CORE_LEVEL_FINISHED, '.', 0});
+        }
+    }
+
+    return;
+}
+
+int advance_beats(core_state &state, const level_schedule &schedule, double time, vector<core_event> &events) {
+    // processes every beat that has elapsed up until time (on the song clock), in order, and returns how many there were
+    int beats_processed = 0;
+
+    while (state.game_over == false && (time - state.beat_start_time) >= state.beat_length) {
+        process_beat(state, schedule, events);
+        check_level_end(state, schedule, events);
+        beats_processed++;
+    }
+
+    return beats_processed;
+}
+
+void core_start(core_state &state, const level_schedule &schedule) {
+    // sets up state to play the level in schedule from the very beginning (song clock at 0)
+
+    // divides a bar by the number of beats in it; this allows for unusual time signatures
+    double one_bar = 60000.0/schedule.bpm;
+    state.beat_length = (one_bar*2) / schedule.time_signature_bottom;
+
+    state.beat_start_time = -state.beat_length;
+    state.intro_length = state.beat_length * schedule.start_offset;
+    state.beat_count = 0;
+    state.song_beat_position = 0;
+
+    reset_shapes(state);
+    reset_sequences(state, schedule);
+    state.previous_shapes.clear();
+
+    state.score = 0;
+    state.combo = 0;
+    state.life = 100;
+    state.song_over = false;
+    state.game_over = false;
+    state.level_finished = false;
+    state.stalled_steps = 0;
+    state.caught_up_beats = 0;
+
+    return;
+}
+
+int core_step(core_state &state, const level_schedule &schedule, double time, const vector<core_input> &inputs, vector<core_event> &events) {
+    // advances the game up until time (on the song clock), judging inputs along the way; returns how many beats were processed
+    // anything that happened is appended to events, in order
+    // ----------------------------------------------------------
+    // time: the current time on the song clock; this should never go backwards between calls
+    // inputs: presses since the last step, in the order they happened
+    int beats_processed = 0;
+
+    // beats are brought up to the time of each press first, so it's judged against the beat it actually landed on
+    for (int i = 0; i < inputs.size(); i++) {
+        beats_processed += advance_beats(state, schedule, inputs[i].time, events);
+        judge_input(state, schedule, inputs[i], events);
+    }
+
+    // locks off the game when lives are 0
+    if (state.game_over) {return beats_processed;}
+
+    // normally this is 0 or 1, but if a step was late (e.g. the thread got descheduled) there can be several
+    beats_processed += advance_beats(state, schedule, time, events);
+
+    if (beats_processed > 1) {
+        state.stalled_steps++;
+        state.caught_up_beats += beats_processed - 1;
+    }
+
+    check_level_end(state, schedule, events);
+
+    return beats_processed;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// the game's rules, kept separate from SDL so they can be run headless (e.g. simulated plays, tests)
+// the game feeds in the time and any inputs through core_step(), and turns the events that come back out into sounds, rumble, etc.
+
+// dedicated struct for a shape, cleaner and faster than using JSON arrays
+struct shape {
+    int type;
+    int x;
+    int y;
+    int scale;
+    int color;
+};
+
+// flags for each beat within a shape's cycle (a CPU phase followed by a player phase)
+// see level_schedule.beat_flags below
+enum beat_flags {
+    BEAT_SHAPE_START = 1,   // first beat of a shape; the previous shape is judged here
+    BEAT_PHASE_SWAP = 2,    // control swaps between CPU and player on this beat
+    BEAT_PLAYER = 4         // the player has control during this beat (otherwise, the CPU does)
+};
+
+// a level compiled down to flat arrays, so the gameplay loop never has to touch the level JSON
+// built by compile_level_schedule() whenever a level is parsed
+// ----------------------------------------------------------
+// arrays with one entry per shape are indexed the same way as level.json, so index 0 is the header and goes unused
+// cpu_ops: the CPU's sequence for every shape, measure_length ops each; shape i starts at i * measure_length
+// colors: color of each shape
+// song_steps: how many beats the song advances when each shape is cleared
+// auto_shapes: every auto-shape in the level, in order; auto_shape_start[i] to auto_shape_start[i+1] belong to shape i
+// beat_flags: beat_flags (see above) for each beat in a cycle, indexed by (beat_count - start_offset) % (measure_length * 2)
+// beat_length_seconds: length of one beat in seconds, used for seeking the song
+struct level_schedule {
+    int bpm;
+    int time_signature_top;
+    int time_signature_bottom;
+    int measure_length;
+    int start_offset;
+    int total_shapes;
+    float beat_length_seconds;
+    std::vector<char> cpu_ops;
+    std::vector<int> colors;
+    std::vector<int> song_steps;
+    std::vector<int> auto_shape_start;
+    std::vector<shape> auto_shapes;
+    std::vector<unsigned char> beat_flags;
+};
+
+// a single button press, already converted to an opcode (see apply_shape_op())
+// time: when it was pressed, in milliseconds on the song clock
+struct core_input {
+    char op;
+    double time;
+};
+
+// things that happen during core_step(), in the order they happened
+enum core_event_type {
+    CORE_BEAT,              // a beat passed; value is the beat number
+    CORE_CPU_OP,            // the CPU did op to its shape
+    CORE_PLAYER_OP,         // the player's input landed within a timing window; value is 1 if it changed their shape, 0 if it didn't
+    CORE_SHAPE_CLEARED,     // the player's shape matched the CPU's
+    CORE_SHAPE_FAILED,      // it didn't
+    CORE_COMBO,             // the combo hit a multiple of 5; value is the combo
+    CORE_SEEK,              // the song should jump to value beats in
+    CORE_PHASE_SWAP,        // control swapped between the CPU and player
+    CORE_RUMBLE,            // a rumble beat during the player's phase
+    CORE_GAME_OVER,         // life hit 0
+    CORE_SONG_OVER,         // the last shape has been placed
+    CORE_LEVEL_FINISHED     // a few beats after the song is over; the level should end now
+};
+
+struct core_event {
+    core_event_type type;
+    char op;
+    int value;
+};
+
+// everything about a level that's currently being played
+// ----------------------------------------------------------
+// beat_start_time: when the current beat started, in milliseconds on the song clock
+// beat_length: length of a beat, in milliseconds
+// intro_length: length of the intro, in milliseconds; inputs aren't judged during it
+// song_beat_position: where in the song we are, in beats (this only moves forward when a shape is cleared)
+// active_shape: the shape the player controls
+// result_shape: the shape the CPU controls, compared with active_shape at the end of every shape
+// stalled_steps/caught_up_beats: how many steps had to process more than one beat, and how many extra beats that was
+struct core_state {
+    double beat_start_time;
+    double beat_length;
+    double intro_length;
+    int beat_count;
+    int song_beat_position;
+    shape active_shape;
+    shape result_shape;
+    std::vector<shape> previous_shapes;
+    std::string cpu_sequence;
+    std::string player_sequence;
+    int score;
+    int combo;
+    int life;
+    bool song_over;
+    bool game_over;
+    bool level_finished;
+    int stalled_steps;
+    int caught_up_beats;
+};
+
+void set_core_debug(bool);
+void compile_beat_flags(level_schedule&);
+
+shape apply_shape_op(char, shape);
+bool compare_shapes(shape, shape);
+bool check_sequence_validity(const std::string&, shape);
+int calculate_score(const std::string&, const std::string&);
+
+// a shape packed down to a single number, so ops can be run on it quickly and in bulk (see apply_packed_op())
+// 0 is the blank shape, followed by every visible shape (3 types, 15 x 15 positions, 8 scales); colors aren't included
+typedef unsigned short packed_shape;
+const int shape_state_count = 1 + 3 * 15 * 15 * 8;
+
+int get_shape_state(shape);
+shape get_state_shape(int);
+packed_shape apply_packed_op(char, packed_shape);
+packed_shape run_packed_sequence(const std::string&, packed_shape);
+
+int get_shape_distance(shape);
+std::string solve_shape_sequence(shape);
+int check_beat_timing_window(const core_state&, const level_schedule&, double);
+
+void core_start(core_state&, const level_schedule&);
+int core_step(core_state&, const level_schedule&, double, const std::vector<core_input>&, std::vector<core_event>&);
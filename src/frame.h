@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "core.h"
+
+// everything draw_game() needs to draw one frame of gameplay, filled in by main.cpp from the latest game snapshot
+// previous_shapes points at the snapshot's list instead of being a copy of it, so it has to be left alone until the frame's drawn
+// ----------------------------------------------------------
+// beat_count, start_offset, measure_length, beat_start_time, beat_advanced, shape_advanced: see bg_data (background.h); the beat is the one being heard, not the one being processed
+// song_start_time, intro_beat_length: used to fade the level's intro in
+// current_ticks: the song clock, as it's heard
+// active_shape: the shape the player is controlling
+// result_shape: the shape the CPU is controlling
+// previous_shapes: every shape placed so far, in order
+// life, score: shown on the HUD
+// grid_toggle: whether the grid lines are drawn over the grid's background
+// hud_toggle: whether the HUD is drawn
+// blindfold_toggle: hides the placed shapes and the player's shape
+// song_over: true when the last shape has been successfully placed
+// game_over: true when the player hits 0% health
+struct game_frame {
+    int beat_count;
+    int start_offset;
+    int measure_length;
+    int song_start_time;
+    double beat_start_time;
+    double current_ticks;
+    int intro_beat_length;
+    bool beat_advanced;
+    bool shape_advanced;
+    shape active_shape;
+    shape result_shape;
+    const std::vector<shape> *previous_shapes;
+    int life;
+    int score;
+    bool grid_toggle;
+    bool hud_toggle;
+    bool blindfold_toggle;
+    bool song_over;
+    bool game_over;
+};
+
+// everything draw_sandbox() needs to draw one frame of sandbox mode; previous_shapes works the same way as it does in game_frame
+// ----------------------------------------------------------
+// active_shape: the shape the player is currently controlling
+// previous_shapes: every shape placed so far, in order
+// menu_open: whether or not the toolbar is visible
+// menu_item: the currently-selected toolbar item
+// sandbox_lock: whether or not shape-locking is active
+// quit_dialog_active: whether or not the "are you sure?" dialog box is open
+// quit_dialog_selected: selection of yes-or-no in the "are you sure?" dialog box
+struct sandbox_frame {
+    shape active_shape;
+    const std::vector<shape> *previous_shapes;
+    bool menu_open;
+    bool sandbox_lock;
+    int menu_item;
+    bool quit_dialog_active;
+    bool quit_dialog_selected;
+};
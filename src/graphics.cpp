@@ -36,7 +36,12 @@
 #include "background.h"
 #include "options.h"
 #include "tutorial.h"
+#include "calibration.h"
 #include "font.h"
+#include "timing.h"
+#include "core.h"
+#include "compositor.h"
+#include "frame.h"
 
 using nlohmann::json;
 using std::string;
@@ -45,19 +50,10 @@ using std::vector;
 
 extern SDL_Window* window;
 extern SDL_Renderer* renderer;
+extern bool software_shapes_toggle;
 
 const float to_rad = 3.1415926535 / 180;
 
-// dedicated struct for a shape, saves some time over using a JSON array
-// doesn't contain sequence data
-struct shape {
-    int type;
-    int x;
-    int y;
-    int scale;
-    int color;
-};
-
 int width  = 1280;
 int height = 720;
 float fade_in  = 255;
@@ -165,7 +161,7 @@ void unload_character_tileset() {
 
 void load_background_tileset() {
     string tile_path = get_background_tile_path();
-    SDL_Surface* temp = IMG_Load(tile_path.c_str());
+    SDL_Surface* temp = IMG_Load_RW(open_level_asset("tile.png"), 1);
 
     if (temp == NULL) {
         printf("[!] %s\n"
@@ -188,7 +184,7 @@ void load_background_tileset() {
 
 void load_character_tileset() {
     string tile_path = get_character_tile_path();
-    SDL_Surface* temp = IMG_Load(tile_path.c_str());
+    SDL_Surface* temp = IMG_Load_RW(open_level_asset("character.png"), 1);
 
     if (temp == NULL) {
         printf("[!] %s\n", SDL_GetError());
@@ -355,6 +351,12 @@ void parse_tile_frames(json file) {
     return;
 }
 
+bool check_hex_string(string string) {
+    // returns true if string is a valid hex-color (see below)
+    const std::regex validate_hex_code ("^#([0-9A-F]{3}){1,2}$", std::regex_constants::icase);
+    return std::regex_match(string, validate_hex_code);
+}
+
 SDL_Color hex_string_to_color(string string) {
     // converts a hex-color string into an SDL_Color
     // used for creating color table values for shapes
@@ -365,8 +367,7 @@ SDL_Color hex_string_to_color(string string) {
     SDL_Color error_color = {255, 0, 255, 255};
     SDL_Color color;
 
-    const std::regex validate_hex_code ("^#([0-9A-F]{3}){1,2}$", std::regex_constants::icase);
-    if (std::regex_match(string, validate_hex_code) == false) {printf("[!] Malformed hex-color: %s (replaced with magenta)\n", string.c_str()); return error_color;}
+    if (check_hex_string(string) == false) {printf("[!] Malformed hex-color: %s (replaced with magenta)\n", string.c_str()); return error_color;}
 
     // removes the # at the beginning of the string
     string.erase(0, 1);
@@ -409,6 +410,13 @@ SDL_Color get_rainbow_color(int time) {
     return {color_r, color_g, color_b, 255};
 }
 
+SDL_Color get_default_color(int col) {
+    // returns a color from the default color table, which levels can override (see set_color_table())
+    if (col > 15 | col < 0) {return {255, 255, 255, 255};}
+
+    return default_color_table[col];
+}
+
 void reset_color_table() {
     for (int i = 0; i < 16; i++) {
         color_table[i] = default_color_table[i];
@@ -428,6 +436,13 @@ void set_color_table(int id, string hex_color) {
     return;
 }
 
+void set_color_table(int id, SDL_Color color) {
+    // same as above, but for colors that have already been converted (ie. from a compiled level)
+    if (id > 15 | id < 0) {return;}
+    color_table[id] = color;
+    return;
+}
+
 void set_combo_timer(int ms) {
     combo_display_timer = ms;
 }
@@ -551,7 +566,7 @@ void draw_background_test(bg_data bg_data, int frame_time) {
 
     SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
     SDL_RenderFillRect(renderer, &shape);
-    draw_text(to_string(bg_data.song_tick), 0, shape.y, 1, 1);
+    draw_text(to_string((int)bg_data.song_tick), 0, shape.y, 1, 1);
 
     // green bar that shows beat length
     shape.y = height - 64;
@@ -559,7 +574,7 @@ void draw_background_test(bg_data bg_data, int frame_time) {
 
     SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
     SDL_RenderFillRect(renderer, &shape);
-    draw_text(to_string(bg_data.beat_tick), 0, shape.y, 1, 1);
+    draw_text(to_string((int)bg_data.beat_tick), 0, shape.y, 1, 1);
 
     // yellow bar that shows peak of last beat
     shape.y = height - 96;
@@ -578,7 +593,7 @@ void draw_background_test(bg_data bg_data, int frame_time) {
     shape.w = width/22 + scale;
     shape.h = shape.w;
 
-    switch (check_beat_timing_window(SDL_GetTicks())) {
+    switch (check_beat_timing_window(get_song_clock())) {
         case 0:
             SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
             break;
@@ -1191,11 +1206,14 @@ void draw_background_kefrens(bg_data bg_data, int frame_time) {
     return;
 }
 
+// the background effect picked by the last call to init_background_effect(), so it isn't looked up every frame
+background_effect current_background_effect = none;
+
 background_effect get_level_background_effect() {
     // converts a background_effect's value to an enum used internally
     // we do this for readability, and because comparing ints are faster than comparing strings
 
-    string background_name = get_level_background_effect_string();
+    const string &background_name = get_level_background_effect_string();
 
     if (background_name == "solid")         return solid;
     if (background_name == "tile")          return tile;
@@ -1214,20 +1232,20 @@ background_effect get_level_background_effect() {
     return none;
 }
 
-void init_background_effect() {
+void init_background_effect(background_effect effect) {
     // Initialize function for background effects
     // Used for setting up things like auxillary textures
     // ----------------------------------------------------------
-    // effect_id: enum for function (see switch statement below)
+    // effect: enum for function (see switch statement below); also used by draw_background_effect() until the next call
 
-    printf("Initializing background effect: %s\n", get_level_background_effect_string().c_str());
+    current_background_effect = effect;
     SDL_DestroyTexture(aux_texture);
     aux_texture_w = 0;
     aux_texture_h = 0;
     aux_int = 0;
     aux_float = 0;
 
-    switch (get_level_background_effect()) {
+    switch (effect) {
         case tile:
             reset_tile_data();
             load_background_tileset();
@@ -1276,6 +1294,25 @@ void init_background_effect() {
     return;
 }
 
+void init_background_effect() {
+    // initializes the current level's background effect
+    printf("Initializing background effect: %s\n", get_level_background_effect_string().c_str());
+    init_background_effect(get_level_background_effect());
+    return;
+}
+
+void reload_background_tileset() {
+    // swaps in a changed tile.png without resetting the rest of the effect; used for hot reloading
+    // tile.json is read again too, since its scale mode is set on the texture
+    if (current_background_effect != tile) {return;}
+
+    SDL_DestroyTexture(aux_texture);
+    load_background_tileset();
+    SDL_QueryTexture(aux_texture, NULL, NULL, &aux_texture_w, &aux_texture_h);
+    load_tile_frame_file();
+    return;
+}
+
 void draw_background_effect(bg_data bg_data, bool draw_debug_bg, int frame_time) {
     // Master function that calls various background FX drawing functions
     // ----------------------------------------------------------
@@ -1288,7 +1325,7 @@ void draw_background_effect(bg_data bg_data, bool draw_debug_bg, int frame_time)
     // resulting in a glitchy background effect
     if (frame_time <= 2) {frame_time = 2;}
 
-    switch (get_level_background_effect()) {
+    switch (current_background_effect) {
         case solid:         draw_background_solid       (bg_data, frame_time);  break;
         case checkerboard:  draw_background_checkerboard(bg_data, frame_time);  break;
         case tile:          draw_background_tile        (bg_data, frame_time);  break;
@@ -1420,74 +1457,293 @@ void draw_game_over(int time) {
     return;
 }
 
-void draw_shape(int type = 0, int x = 7, int y = 7, int scale = 1, SDL_Color rgb = {0, 0, 0, 255}, int gx = 0, int gy = 0, float gscale = height/22.f) {
-    // Shape-drawing function, used to render every shape
-    // ----------------------------------------------------------
-    // shape: type of shape to draw (range: 0-2; -1 = no draw)
-    // x, y: position on grid       (range: 0-14)
-    // scale: size in grid squares  (range: 1-8)
-    // rgb: color of shape in RGBA values
-    // gx, gy: position of drawgrid (can be used as an offset)
-    // gscale: size of 1 grid square in pixels
+// shape batching
+// shapes are broken down into triangles and queued up by queue_shape(), then drawn all at once with a single SDL_RenderGeometry() call by draw_queued_shapes()
+// triangles are drawn in the order they're queued, plain ones using the current draw blend mode, so overlapping shapes (and "erase" colors) come out the same as drawing them one at a time
+// ----------------------------------------------------------
+// shape_vertices/shape_indices: the queued triangles; kept around between frames so they don't have to be reallocated
+// circle_max_error: how far (in pixels) a circle's edges can be from a true circle, which decides how many triangles it's made of
+// shape_batch_texture: the texture the queued triangles are drawn with; NULL for plain triangles, or the shape atlas (see below)
+// shape_batch_blend: the blend mode the atlas is drawn with, when that's the texture
+vector<SDL_Vertex> shape_vertices;
+vector<int> shape_indices;
+SDL_Texture *shape_batch_texture = NULL;
+SDL_BlendMode shape_batch_blend = SDL_BLENDMODE_BLEND;
+const float circle_max_error = 0.25;
+
+// the shape atlas: every shape type at every scale, drawn once with anti-aliased edges at the size grid squares currently are
+// opaque shapes at that size are copied out of it as textured quads (which still go in the same batch) instead of being broken down into triangles
+// it's redrawn whenever grid squares change size (i.e. the window's been resized); shapes at any other size are drawn as plain triangles
+// ----------------------------------------------------------
+// shape_atlas_scale: the grid square size it was drawn at, 0 if it hasn't been
+// shape_atlas_rects: where each shape is in it, by [type][scale - 1]; each one's centered in its rect, and has a pixel of space around it
+// shape_atlas_blend: blend mode for drawing from the atlas; the shape layer keeps premultiplied colors while the atlas is in use, so edges blend properly
+// shape_layer_blend: blend mode for drawing the (premultiplied) shape layer onto the screen
+// shape_erase_blend/shape_fill_blend: translucent shapes replace what's under them on the shape layer, so they're drawn in two passes with these
+// the first scales what's there down by the shape's coverage, then the second adds the (premultiplied) color back in by the same amount
+SDL_Texture *shape_atlas = NULL;
+float shape_atlas_scale = 0;
+SDL_Rect shape_atlas_rects[3][8];
+SDL_BlendMode shape_atlas_blend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_SRC_ALPHA, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+SDL_BlendMode shape_layer_blend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+SDL_BlendMode shape_erase_blend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+SDL_BlendMode shape_fill_blend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_SRC_ALPHA, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD);
+bool drawing_shape_layer = false; // true while shapes are being drawn onto the shape layer, so translucent colors can be premultiplied (or cut out of the atlas, see queue_shape())
+
+int get_circle_segments(float r) {
+    // returns how many triangles a circle of radius r needs to look round (see circle_max_error above)
+    if (r <= circle_max_error * 2) {return 8;}
+
+    int segments = ceil(180 * to_rad / acos(1 - circle_max_error / r));
+    return fmin(fmax(segments, 8), 256);
+}
 
-    SDL_SetRenderDrawColor(renderer, rgb.r, rgb.g, rgb.b, rgb.a);
+float get_shape_coverage(int type, float size, float dx, float dy) {
+    // returns how much of a pixel (from 0 to 1) a shape covers, given how far the pixel's center is from the shape's center
+    // this is worked out from the distance to the shape's nearest edge, which is as good as supersampling for edges this simple
+    float half = size / 2;
+    float distance;
 
-    x = gscale * (x + 0.5) + gx;
-    y = gscale * (y + 0.5) + gy;
+    switch (type) {
+        case 0:
+            distance = half - sqrt(dx*dx + dy*dy);
+            break;
+
+        case 1:
+            return fmin(fmax(half - fabs(dx) + 0.5, 0), 1) * fmin(fmax(half - fabs(dy) + 0.5, 0), 1);
+
+        // the triangle's sides go out half a pixel for every pixel down, so their distance is scaled by 1/sqrt(5)
+        case 2:
+            distance = fmin(half - dy, (dy + half - 2 * fabs(dx)) / sqrt(5.f));
+            break;
+
+        default:
+            return 0;
+    }
+
+    return fmin(fmax(distance + 0.5, 0), 1);
+}
+
+void reset_shape_atlas() {
+    // throws the shape atlas out, so it's redrawn the next time it's needed; needed if the renderer loses its textures
+    SDL_DestroyTexture(shape_atlas);
+    shape_atlas = NULL;
+    shape_atlas_scale = 0;
+    return;
+}
+
+void build_shape_atlas(float gscale) {
+    // draws every shape at every scale into the shape atlas, sized for grid squares of gscale pixels
+    // if the renderer can't fit it in a texture, or can't do the blend modes it needs, there just isn't an atlas
+    SDL_RendererInfo info;
+    int max_width = 4096;
+    int max_height = 4096;
+
+    reset_shape_atlas();
+    shape_atlas_scale = gscale;
+
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0) {
+        max_width = info.max_texture_width;
+        max_height = info.max_texture_height;
+    }
+
+    // packs the shapes in rows, biggest first
+    int atlas_w = 0;
+    int row_x = 0;
+    int row_y = 0;
+    int row_h = 0;
+
+    for (int scale = 8; scale >= 1; scale--) {
+        for (int type = 0; type < 3; type++) {
+            int size = gscale * (1 + 2 * (scale-1));
+            int cell = (size + 3) & ~1; // even, so the shape's center lands on a pixel boundary like it does when drawn directly
+
+            if (row_x + cell > max_width) {
+                row_x = 0;
+                row_y += row_h;
+                row_h = 0;
+            }
+
+            shape_atlas_rects[type][scale - 1] = {row_x, row_y, cell, cell};
+            row_x += cell;
+            row_h = fmax(row_h, cell);
+            atlas_w = fmax(atlas_w, row_x);
+        }
+    }
+
+    if (row_y + row_h > max_height) {
+        printf("[!] Shape atlas is too big for this renderer, drawing shapes without it.\n");
+        return;
+    }
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, atlas_w, row_y + row_h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {return;}
+
+    // shapes are white, so they can be tinted any color with vertex colors; only the alpha (coverage) changes
+    for (int type = 0; type < 3; type++) {
+        for (int scale = 1; scale <= 8; scale++) {
+            SDL_Rect rect = shape_atlas_rects[type][scale - 1];
+            float size = (int)(gscale * (1 + 2 * (scale-1)));
+            float center = rect.w / 2;
+
+            for (int py = 0; py < rect.h; py++) {
+                Uint8 *row = (Uint8*) surface->pixels + (rect.y + py) * surface->pitch + rect.x * 4;
+
+                for (int px = 0; px < rect.w; px++) {
+                    row[px * 4 + 0] = 255;
+                    row[px * 4 + 1] = 255;
+                    row[px * 4 + 2] = 255;
+                    row[px * 4 + 3] = get_shape_coverage(type, size, px + 0.5 - center, py + 0.5 - center) * 255 + 0.5;
+                }
+            }
+        }
+    }
+
+    shape_atlas = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+
+    if (shape_atlas == NULL) {return;}
+
+    // the blend modes are all custom ones, which not every renderer supports (support doesn't depend on the texture, so the atlas is used to check)
+    bool blend_supported = true;
+
+    for (SDL_BlendMode mode: {shape_layer_blend, shape_erase_blend, shape_fill_blend, shape_atlas_blend}) {
+        if (SDL_SetTextureBlendMode(shape_atlas, mode) != 0) {blend_supported = false;}
+    }
+
+    if (!blend_supported) {
+        printf("[!] Renderer doesn't support the shape atlas's blend modes, drawing shapes without it.\n");
+        SDL_DestroyTexture(shape_atlas);
+        shape_atlas = NULL;
+        return;
+    }
+
+    SDL_SetTextureScaleMode(shape_atlas, SDL_ScaleModeNearest);
+    printf("Built shape atlas (%ix%i) for %.1f pixel grid squares.\n", atlas_w, row_y + row_h, gscale);
+    return;
+}
+
+void prepare_shape_atlas(float gscale) {
+    // makes sure the shape atlas is drawn for grid squares of gscale pixels
+    if (gscale != shape_atlas_scale) {build_shape_atlas(gscale);}
+    return;
+}
+
+void draw_queued_shapes();
+
+void set_shape_batch(SDL_Texture *texture, SDL_BlendMode blend = SDL_BLENDMODE_BLEND) {
+    // switches the queue over to drawing with texture (and blend, for the atlas), drawing whatever's already queued first so everything stays in order
+    if (texture == shape_batch_texture && (texture == NULL || blend == shape_batch_blend)) {return;}
+
+    draw_queued_shapes();
+    shape_batch_texture = texture;
+    shape_batch_blend = blend;
+    return;
+}
+
+void queue_atlas_shape(int type, int scale, float cx, float cy, SDL_Color rgb) {
+    // queues a shape as a quad copied out of the shape atlas, centered on cx, cy; the batch has to be set to the atlas first
+    SDL_Rect rect = shape_atlas_rects[type][scale - 1];
+    float left = cx - rect.w / 2;
+    float top = cy - rect.h / 2;
+    float atlas_w, atlas_h;
+    int w, h;
+    int first = shape_vertices.size();
+
+    SDL_QueryTexture(shape_atlas, NULL, NULL, &w, &h);
+    atlas_w = w;
+    atlas_h = h;
+
+    shape_vertices.push_back({{left, top}, rgb, {rect.x / atlas_w, rect.y / atlas_h}});
+    shape_vertices.push_back({{left + rect.w, top}, rgb, {(rect.x + rect.w) / atlas_w, rect.y / atlas_h}});
+    shape_vertices.push_back({{left + rect.w, top + rect.h}, rgb, {(rect.x + rect.w) / atlas_w, (rect.y + rect.h) / atlas_h}});
+    shape_vertices.push_back({{left, top + rect.h}, rgb, {rect.x / atlas_w, (rect.y + rect.h) / atlas_h}});
+
+    for (int i: {0, 1, 2, 0, 2, 3}) {shape_indices.push_back(first + i);}
+    return;
+}
+
+void queue_shape(int type = 0, int x = 7, int y = 7, int scale = 1, SDL_Color rgb = {0, 0, 0, 255}, int gx = 0, int gy = 0, float gscale = height/22.f) {
+    // queues a shape up to be drawn by draw_queued_shapes(); takes the same parameters as draw_shape()
+    float cx = (int)(gscale * (x + 0.5) + gx);
+    float cy = (int)(gscale * (y + 0.5) + gy);
     int size = gscale * (1 + 2 * (scale-1));
-    SDL_Rect shape;
+    int first = shape_vertices.size();
+
+    // shapes come out of the atlas if it's been drawn at this size
+    // translucent ones (including "erase" colors) replace what's under them rather than blending, so on the shape layer they're cut out first, then filled back in
+    // anywhere else, a translucent shape is drawn as plain triangles
+    if (shape_atlas != NULL && gscale == shape_atlas_scale && type >= 0 && type <= 2 && scale >= 1 && scale <= 8) {
+        if (rgb.a == 255) {
+            set_shape_batch(shape_atlas, shape_atlas_blend);
+            queue_atlas_shape(type, scale, cx, cy, rgb);
+            return;
+        }
+
+        if (drawing_shape_layer) {
+            set_shape_batch(shape_atlas, shape_erase_blend);
+            queue_atlas_shape(type, scale, cx, cy, {0, 0, 0, 255});
+
+            if (rgb.a > 0) {
+                set_shape_batch(shape_atlas, shape_fill_blend);
+                queue_atlas_shape(type, scale, cx, cy, rgb);
+            }
+
+            return;
+        }
+    }
+
+    set_shape_batch(NULL);
+    first = shape_vertices.size();
+
+    // the shape layer holds premultiplied colors while the atlas is in use (see above)
+    if (drawing_shape_layer && shape_atlas != NULL) {
+        rgb = {(Uint8)(rgb.r * rgb.a / 255), (Uint8)(rgb.g * rgb.a / 255), (Uint8)(rgb.b * rgb.a / 255), rgb.a};
+    }
 
     switch (type) {
-        // circle
+        // circle; a fan of triangles around the center
         case 0: {
-            int y1, y2;
             float r = gscale/2 * (1 + 2 * (scale-1));
+            int segments = get_circle_segments(r);
 
-            for (y1 = -r, y2 = r; y1; y1++, y2--) {
-                int xr = (int)(sqrt(r*r - y1*y1) + 0.5);
+            shape_vertices.push_back({{cx, cy}, rgb, {0, 0}});
 
-                shape.x = x - xr;
-                shape.y = y + y1;
-                shape.w = 2 * xr;
-                shape.h = 1;
-                SDL_RenderFillRect(renderer, &shape);
+            for (int i = 0; i < segments; i++) {
+                float angle = i * 360.0 / segments * to_rad;
+                shape_vertices.push_back({{cx + r * (float)cos(angle), cy + r * (float)sin(angle)}, rgb, {0, 0}});
 
-                shape.y = y + y2;
-                SDL_RenderFillRect(renderer, &shape);
+                shape_indices.push_back(first);
+                shape_indices.push_back(first + 1 + i);
+                shape_indices.push_back(first + 1 + (i + 1) % segments);
             }
 
-            shape.x = x - r;
-            shape.y = y;
-            shape.w = 2 * r;
-            shape.h = 1;
-
-            SDL_RenderFillRect(renderer, &shape);
             return;
         }
 
         // square
         case 1: {
-            shape.x = x - (size * 0.5);
-            shape.y = y - (size * 0.5);
-            shape.w = shape.h = size;
+            float left = (int)(cx - (size * 0.5));
+            float top = (int)(cy - (size * 0.5));
 
-            SDL_RenderFillRect(renderer, &shape);
+            shape_vertices.push_back({{left, top}, rgb, {0, 0}});
+            shape_vertices.push_back({{left + size, top}, rgb, {0, 0}});
+            shape_vertices.push_back({{left + size, top + size}, rgb, {0, 0}});
+            shape_vertices.push_back({{left, top + size}, rgb, {0, 0}});
+
+            for (int i: {0, 1, 2, 0, 2, 3}) {shape_indices.push_back(first + i);}
             return;
         }
 
-        // triangle
+        // triangle; point up, as wide as it is tall
         case 2: {
-            int y1 = y - (size * 0.5);
-            int y2 = y1 + size;
+            float top = (int)(cy - (size * 0.5));
 
-            for (int y3 = 0; y1 < y2; y1++, y3++) {
-                shape.x = (x - (size*0.25)) + ((y-y1) * 0.5);
-                shape.y = y1;
-                shape.w = y3;
-                shape.h = 1;
+            shape_vertices.push_back({{cx, top}, rgb, {0, 0}});
+            shape_vertices.push_back({{cx + size * 0.5f, top + size}, rgb, {0, 0}});
+            shape_vertices.push_back({{cx - size * 0.5f, top + size}, rgb, {0, 0}});
 
-                SDL_RenderFillRect(renderer, &shape);
-            }
+            for (int i: {0, 1, 2}) {shape_indices.push_back(first + i);}
             return;
         }
 
@@ -1500,6 +1756,186 @@ void draw_shape(int type = 0, int x = 7, int y = 7, int scale = 1, SDL_Color rgb
     return;
 }
 
+void draw_queued_shapes() {
+    // draws every shape queued up by queue_shape() in a single call, then empties the queue
+    if (shape_indices.empty()) {return;}
+
+    if (shape_batch_texture != NULL) {SDL_SetTextureBlendMode(shape_batch_texture, shape_batch_blend);}
+    SDL_RenderGeometry(renderer, shape_batch_texture, shape_vertices.data(), shape_vertices.size(), shape_indices.data(), shape_indices.size());
+
+    shape_vertices.clear();
+    shape_indices.clear();
+    return;
+}
+
+void draw_shape(int type = 0, int x = 7, int y = 7, int scale = 1, SDL_Color rgb = {0, 0, 0, 255}, int gx = 0, int gy = 0, float gscale = height/22.f) {
+    // Shape-drawing function, used to render single shapes; anything drawing more than one at once should queue them up instead (see above)
+    // ----------------------------------------------------------
+    // shape: type of shape to draw (range: 0-2; -1 = no draw)
+    // x, y: position on grid       (range: 0-14)
+    // scale: size in grid squares  (range: 1-8)
+    // rgb: color of shape in RGBA values
+    // gx, gy: position of drawgrid (can be used as an offset)
+    // gscale: size of 1 grid square in pixels
+
+    queue_shape(type, x, y, scale, rgb, gx, gy, gscale);
+    draw_queued_shapes();
+    return;
+}
+
+// the shape layer: placed shapes, drawn onto a texture that's kept between frames so they don't all have to be redrawn every time
+// shapes are drawn onto a texture in the first place so "erase" colors work (see draw_shape_layer())
+// ----------------------------------------------------------
+// shape_layer_shapes: the shapes currently drawn on the layer, in order
+// shape_layer_palette: the colors they were drawn in
+// shape_layer_premultiplied: whether it holds premultiplied colors, which it does whenever the shape atlas is in use
+// shape_layer_software: whether it's drawn by the software compositor (see compositor.cpp) into shape_layer_canvas, then uploaded
+SDL_Texture *shape_layer = NULL;
+int shape_layer_size = 0;
+bool shape_layer_premultiplied = false;
+bool shape_layer_software = false;
+shape_canvas shape_layer_canvas;
+vector<shape> shape_layer_shapes;
+SDL_Color shape_layer_palette[16];
+
+void reset_shape_layer() {
+    // throws the shape layer out, so it's rebuilt the next time it's drawn; needed whenever render targets are lost
+    SDL_DestroyTexture(shape_layer);
+    shape_layer = NULL;
+    shape_layer_shapes.clear();
+    return;
+}
+
+bool check_software_shapes() {
+    // returns true if the shape layer should be drawn in software rather than by the renderer
+    // that's the case if it's been asked for (-software-shapes), or if the renderer's a software one anyway, where the compositor's a lot faster
+    SDL_RendererInfo info;
+
+    if (software_shapes_toggle) {return true;}
+    return SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE);
+}
+
+bool check_shape_layer(const vector<shape> &shapes) {
+    // returns true if the layer can be brought up to date by only drawing the shapes after the ones already on it
+    // anything else (a shape changing or being removed, a new level, new colors) means it has to be redrawn from scratch
+    if (shapes.size() < shape_layer_shapes.size()) {return false;}
+
+    for (int i = 0; i < shape_layer_shapes.size(); i++) {
+        if (!compare_shapes(shapes[i], shape_layer_shapes[i]) || shapes[i].color != shape_layer_shapes[i].color) {return false;}
+    }
+
+    for (int i = 0; i < 16; i++) {
+        SDL_Color color = get_color(i);
+        SDL_Color old_color = shape_layer_palette[i];
+        if (color.r != old_color.r || color.g != old_color.g || color.b != old_color.b || color.a != old_color.a) {return false;}
+    }
+
+    return true;
+}
+
+void draw_shape_layer(const vector<shape> &shapes, SDL_Rect grid_area) {
+    // draws every shape in shapes onto the screen at grid_area, by way of the shape layer
+    // only shapes that have been added since the last call are actually drawn; the rest are already on the layer
+    // in software, the layer's a streaming texture that the canvas is copied into; it never has to be a render target
+    SDL_Texture *target = SDL_GetRenderTarget(renderer);
+    int first_shape = shape_layer_shapes.size();
+    bool software = check_software_shapes();
+
+    prepare_shape_atlas(grid_area.w/15);
+
+    if (shape_layer == NULL || shape_layer_size != grid_area.w || shape_layer_software != software || shape_layer_premultiplied != (shape_atlas != NULL && !software)) {
+        reset_shape_layer();
+
+        if (software) {
+            shape_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, grid_area.w, grid_area.w);
+            resize_shape_canvas(shape_layer_canvas, grid_area.w);
+            printf("Drawing shapes in software (%s).\n", get_span_fill_name());
+        } else {
+            shape_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, grid_area.w, grid_area.w);
+        }
+
+        shape_layer_size = grid_area.w;
+        shape_layer_software = software;
+        shape_layer_premultiplied = shape_atlas != NULL && !software;
+        SDL_SetTextureBlendMode(shape_layer, shape_layer_premultiplied ? shape_layer_blend : SDL_BLENDMODE_BLEND);
+        first_shape = -1;
+    } else if (!check_shape_layer(shapes)) {
+        first_shape = -1;
+    }
+
+    if (shape_layer_software) {
+        if (first_shape == -1) {
+            clear_shape_canvas(shape_layer_canvas);
+            shape_layer_shapes.clear();
+            first_shape = 0;
+
+            for (int i = 0; i < 16; i++) {shape_layer_palette[i] = get_color(i);}
+        }
+
+        for (int i = first_shape; i < shapes.size(); i++) {
+            SDL_Color color = get_color(shapes[i].color);
+            unsigned char rgba[4] = {color.r, color.g, color.b, color.a};
+            fill_canvas_shape(shape_layer_canvas, shapes[i], rgba, grid_area.w/15);
+        }
+
+        shape_layer_shapes.insert(shape_layer_shapes.end(), shapes.begin() + first_shape, shapes.end());
+
+        // only the rows that changed get uploaded, all in one go
+        int top = shape_layer_canvas.dirty_top;
+        int bottom = shape_layer_canvas.dirty_bottom;
+
+        if (top < bottom) {
+            SDL_Rect rows = {0, top, shape_layer_canvas.size, bottom - top};
+            SDL_UpdateTexture(shape_layer, &rows, &shape_layer_canvas.pixels[top * shape_layer_canvas.size], shape_layer_canvas.size * 4);
+            mark_shape_canvas_clean(shape_layer_canvas);
+        }
+    } else if (first_shape < (int) shapes.size()) {
+        // the main loop throws the layer out on SDL_RENDER_TARGETS_RESET and SDL_RENDER_DEVICE_RESET, but a lost device doesn't always send one in time
+        // if the layer can't be drawn to, it's thrown out here too and rebuilt from scratch next frame, rather than kept with shapes missing from it
+        if (SDL_SetRenderTarget(renderer, shape_layer) != 0) {
+            reset_shape_layer();
+            SDL_SetRenderTarget(renderer, target);
+            return;
+        }
+
+        // starting over also clears out any garbage data that the texture might have
+        // fixes a very nasty feedback loop bug in "real" fullscreen
+        if (first_shape == -1) {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+            SDL_RenderClear(renderer);
+            shape_layer_shapes.clear();
+            first_shape = 0;
+
+            for (int i = 0; i < 16; i++) {shape_layer_palette[i] = get_color(i);}
+        }
+
+        drawing_shape_layer = true;
+
+        for (int i = first_shape; i < shapes.size(); i++) {
+            queue_shape(shapes[i].type, shapes[i].x, shapes[i].y, shapes[i].scale, get_color(shapes[i].color), 0, 0, grid_area.w/15);
+        }
+
+        draw_queued_shapes();
+        drawing_shape_layer = false;
+        shape_layer_shapes.insert(shape_layer_shapes.end(), shapes.begin() + first_shape, shapes.end());
+        SDL_SetRenderTarget(renderer, target);
+    }
+
+    SDL_RenderCopy(renderer, shape_layer, NULL, &grid_area);
+    return;
+}
+
+void draw_grid_shape(shape s, SDL_Color rgb, SDL_Rect grid_area) {
+    // draws a single shape straight onto the screen, on top of the shape layer and cut off at the edges of the grid like it is
+    // used for the shape that's being controlled, which changes too often to be worth putting on the layer
+    // it's blended onto what's already there, so erase colors don't work here; see draw_sandbox() for how those are drawn
+    prepare_shape_atlas(grid_area.w/15);
+    SDL_RenderSetClipRect(renderer, &grid_area);
+    draw_shape(s.type, s.x, s.y, s.scale, rgb, grid_area.x, grid_area.y, grid_area.w/15);
+    SDL_RenderSetClipRect(renderer, NULL);
+    return;
+}
+
 void draw_shape_outline(int type = 0, int x = 7, int y = 7, int scale = 1, SDL_Color rgb = {0, 0, 0, 255}, int gx = 0, int gy = 0, float gscale = height/22.f) {
     // similar to the above, but it only renders outlines
     // NOTE: this function is not alpha-safe, at least for circles!
@@ -1625,24 +2061,33 @@ void draw_menu_background(int frame_time) {
         int x = (i * shape_size);
         int y = height/2 + (sin((time + (i*64)) * to_rad) * shape_size);
 
-        draw_shape(i%3, 0, 0, 1, {255,255,255,64}, x, y, shape_size);
+        queue_shape(i%3, 0, 0, 1, {255,255,255,64}, x, y, shape_size);
     }
 
+    draw_queued_shapes();
+
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
     return;
 }
 
-void draw_fps(bool toggle, int fps, int frame_time) {
+void draw_fps(bool toggle, int fps, double frame_time, double frame_time_deviation) {
+    // frame_time_deviation: standard deviation of the frame time over the last second, shows how evenly frames are paced
     if (toggle) {
+        char frame_time_buffer[32];
+        char deviation_buffer[32];
+        snprintf(frame_time_buffer, sizeof(frame_time_buffer), "%.2f ms", frame_time);
+        snprintf(deviation_buffer, sizeof(deviation_buffer), "+/-%.2f ms", frame_time_deviation);
+
         string fps_string = to_string(fps).append(" FPS");
-        string frame_time_string = to_string(frame_time).append(" ms");
+        string frame_time_string = frame_time_buffer;
+        string deviation_string = deviation_buffer;
 
         // draws a black, transparent rectangle underneath the FPS text
         SDL_Rect rect;
 
-        rect.w = (font->w/95) * 8;
-        rect.h = font->h * 2;
+        rect.w = (font->w/95) * fmax(8, deviation_string.length());
+        rect.h = font->h * 3;
         rect.x = 0;
         rect.y = 0;
 
@@ -1654,6 +2099,7 @@ void draw_fps(bool toggle, int fps, int frame_time) {
         // does the actual FPS text rendering
         draw_text(fps_string, 0, 0, 1, 1);
         draw_text(frame_time_string, 0, font->h, 1, 1);
+        draw_text(deviation_string, 0, font->h * 2, 1, 1);
     }
     return;
 }
@@ -1757,11 +2203,12 @@ bool draw_warning(int frame_time) {
     int scale_mul = fmax(floor(height/360), 1);
 
     // Draws the eye icon
-    draw_shape(0, 5, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
-    draw_shape(0, 9, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
-    draw_shape(1, 7, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
-    draw_shape(0, 7, 3, 2, {64, 64, 72, 255},       width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
-    draw_shape(2, 7, 3, 1, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    queue_shape(0, 5, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    queue_shape(0, 9, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    queue_shape(1, 7, 3, 3, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    queue_shape(0, 7, 3, 2, {64, 64, 72, 255},       width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    queue_shape(2, 7, 3, 1, {255, 255, 255, 255},    width/2 - height/22 * 7.5, height/2 - height/22 * 7.5);
+    draw_queued_shapes();
 
     // Draws all the warning text
     draw_text(get_lang_string("warning.header"), width/2, height/12, scale_mul + 1, 0);
@@ -1934,7 +2381,7 @@ bool draw_options(int frame_time) {
     return true;
 }
 
-bool draw_level_select(vector<shape> shapes, int frame_time) {
+bool draw_level_select(const vector<shape> &shapes, int frame_time) {
     // Draws the level select menu
     // ----------------------------------------------------------
     // shapes: list of shapes to draw, created at parse-time in main.cpp
@@ -1944,9 +2391,8 @@ bool draw_level_select(vector<shape> shapes, int frame_time) {
     // calculates the size of the shape grid; this will be used to create a texture that our shapes are drawn on later
     SDL_Rect grid_area = get_grid_shape_area(width/2, height/2, height/22);
 
-    // json_file is set to NULL if it cannot be parsed properly
-    // if it returns NULL, we draw an error screen instead
-    if (!check_json_validity()) {
+    // if the level couldn't be loaded, we draw an error screen instead
+    if (!check_level_loaded()) {
         draw_gradient(0, 0, width, height, {255, 32, 96});
         draw_grid(width/2, height/2, height/22, {0, 0, 0, 255}, true);
 
@@ -1956,14 +2402,15 @@ bool draw_level_select(vector<shape> shapes, int frame_time) {
         // draws a ! mark
         // note the use of Uint8 here is due to SDL_Color's specifications
         Uint8 blue_component = fmax(color_pulse, 0);
-        draw_shape(2, 7, 7,  8, {255, 255, blue_component, 255},    grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(0, 7, 12, 1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 10, 1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 9,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 8,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 7,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 6,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
-        draw_shape(1, 7, 5,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(2, 7, 7,  8, {255, 255, blue_component, 255},    grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(0, 7, 12, 1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 10, 1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 9,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 8,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 7,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 6,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        queue_shape(1, 7, 5,  1, {0, 0, 0, 255},     grid_area.x, grid_area.y, grid_area.w/15);
+        draw_queued_shapes();
 
         draw_text(get_lang_string("levelselect.error1"), width/2, grid_area.y + grid_area.h + 16, scale_mul, 0, width, {255, 192, 32});
         draw_text(get_lang_string("levelselect.error2"), width/2, grid_area.y + grid_area.h + (font->h * scale_mul) + 16, scale_mul, 0);
@@ -1971,29 +2418,8 @@ bool draw_level_select(vector<shape> shapes, int frame_time) {
         draw_gradient(0, 0, width, height, {0, 0, 255});
         draw_grid(width/2, height/2, height/22, get_color(get_bg_color()), true);
 
-        // all shapes are rendered to a texture in order to allow for "erase" colors to function
-        SDL_Texture *shape_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, grid_area.w, grid_area.w);
-        SDL_SetRenderTarget(renderer, shape_texture);
-
-        // clear out any garbage data that the texture might have
-        // fixes a very nasty feedback loop bug in "real" fullscreen
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
-
-        for (int i = 0; i < shapes.size(); i++) {
-            draw_shape(
-                shapes[i].type,
-                shapes[i].x,
-                shapes[i].y,
-                shapes[i].scale,
-                get_color(shapes[i].color),
-                0, 0, grid_area.w/15);
-        }
-
-        SDL_SetTextureBlendMode(shape_texture, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderTarget(renderer, NULL);
-        SDL_RenderCopy(renderer, shape_texture, NULL, &grid_area);
-        SDL_DestroyTexture(shape_texture);
+        // the level's face only has to be drawn again when a different level is selected (see draw_shape_layer())
+        draw_shape_layer(shapes, grid_area);
 
         // display level name and playlist
         // also set up some variables that'll be used for alignment
@@ -2033,29 +2459,25 @@ bool draw_level_select(vector<shape> shapes, int frame_time) {
     return true;
 }
 
-bool draw_game(int beat_count, int start_offset, int measure_length, int song_start_time, float beat_start_time, int current_ticks, int intro_beat_length, bool beat_advanced, bool shape_advanced, shape active_shape, shape result_shape, vector<shape> previous_shapes, bool grid_toggle, bool hud_toggle, bool blindfold_toggle, bool song_over, bool game_over, int frame_time) {
+bool draw_game(const game_frame &frame, int frame_time) {
     // Main function used during gameplay
     // ----------------------------------------------------------
-    // TODO: the # of arguments here could be heavily reduced with "get_foobar"-style functions
-    // See background.h for bg_data parameters
-    // active_shape: The shape the player is controlling
-    // result_shape: The shape the CPU is controlling
-    // previous_shapes: Array of all previously-placed shapes
-    // grid_toggle: Toggles whether to draw the grid pattern
-    // song_over: True when the last shape has been successfully placed
-    // game_over: True when the player hits 0% health
+    // frame: everything to be drawn (see game_frame in frame.h)
 
     SDL_RenderClear(renderer);
     SDL_Color bg_color = get_color(get_bg_color());
 
+    int beat_count = frame.beat_count;
+    int start_offset = frame.start_offset;
+    int measure_length = frame.measure_length;
     int character_beat_count = ((beat_count - start_offset) <= 0) ? 0: (beat_count - (start_offset + 1));
 
     // sets up bg_data
     bg_data bg_data = {
-        (current_ticks - song_start_time),
-        (int)(current_ticks - beat_start_time),
-        beat_advanced,
-        shape_advanced,
+        (float)(frame.current_ticks - frame.song_start_time),
+        (float)(frame.current_ticks - frame.beat_start_time),
+        frame.beat_advanced,
+        frame.shape_advanced,
         beat_count - 1,
         start_offset - 1,
         measure_length,
@@ -2067,83 +2489,42 @@ bool draw_game(int beat_count, int start_offset, int measure_length, int song_st
     // even if it's at the cost of everything else
     draw_background_effect(bg_data, true, frame_time);
     draw_character(character_beat_count);
-    draw_grid(width/2, height/2, height/22, bg_color, !grid_toggle);
+    draw_grid(width/2, height/2, height/22, bg_color, !frame.grid_toggle);
 
     SDL_Rect grid_area = get_grid_shape_area(width/2, height/2, height/22);
 
-    // all shapes are rendered to a texture in order to allow for "erase" colors to function
-    SDL_Texture *shape_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, grid_area.w, grid_area.w);
-    SDL_SetRenderTarget(renderer, shape_texture);
+    // draws every previous shape; only a newly-placed shape actually gets drawn (see draw_shape_layer())
+    static const vector<shape> no_shapes;
+    draw_shape_layer(frame.blindfold_toggle ? no_shapes : *frame.previous_shapes, grid_area);
 
-    // clear out any garbage data that the texture might have
-    // fixes a nasty feedback loop bug in "real" fullscreen
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-    SDL_RenderClear(renderer);
-
-    // draws every previous shape
-    if (!blindfold_toggle) {
-        for (int i = 0; i < previous_shapes.size(); i++) {
-            draw_shape(
-                previous_shapes[i].type,
-                previous_shapes[i].x,
-                previous_shapes[i].y,
-                previous_shapes[i].scale,
-                get_color(previous_shapes[i].color),
-                0, 0, grid_area.w/15);
-        }
-    }
-
-    if (song_over == false && game_over == false && beat_count > start_offset) {
+    // the CPU's and player's shapes go on top, since they change every beat
+    if (frame.song_over == false && frame.game_over == false && beat_count > start_offset) {
         // this draws the CPU's shape
         if ((beat_count - 1 - start_offset)%(measure_length*2) < measure_length) {
-            draw_shape(
-                result_shape.type,
-                result_shape.x,
-                result_shape.y,
-                result_shape.scale,
-                get_rainbow_color(current_ticks),
-                0, 0, grid_area.w/15);
+            draw_grid_shape(frame.result_shape, get_rainbow_color(frame.current_ticks), grid_area);
         }
 
         // this draws the player's shape
-        if (!blindfold_toggle) {
+        if (!frame.blindfold_toggle) {
             if ((beat_count - 1 - start_offset)%(measure_length*2) >= measure_length) {
-                draw_shape(
-                    active_shape.type,
-                    active_shape.x,
-                    active_shape.y,
-                    active_shape.scale,
-                    get_rainbow_color(current_ticks),
-                    0, 0, grid_area.w/15);
+                draw_grid_shape(frame.active_shape, get_rainbow_color(frame.current_ticks), grid_area);
             }
         }
     }
 
-    // draws the shapes onto the screen
-    SDL_SetTextureBlendMode(shape_texture, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderTarget(renderer, NULL);
-    SDL_RenderCopy(renderer, shape_texture, NULL, &grid_area);
-    SDL_DestroyTexture(shape_texture);
-
     // draws the HUD elements
-    if (game_over) {draw_game_over(current_ticks);}
-    if (hud_toggle) {draw_hud(get_life(), get_score(), current_ticks, frame_time);}
+    if (frame.game_over) {draw_game_over(frame.current_ticks);}
+    if (frame.hud_toggle) {draw_hud(frame.life, frame.score, frame.current_ticks, frame_time);}
 
-    draw_level_intro_fade(song_start_time, current_ticks, intro_beat_length);
+    draw_level_intro_fade(frame.song_start_time, frame.current_ticks, frame.intro_beat_length);
     draw_fade(255, 8, frame_time);
     return true;
 }
 
-bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_open, bool sandbox_lock, int menu_item, bool quit_dialog_active, bool quit_dialog_selected, int frame_time) {
+bool draw_sandbox(const sandbox_frame &frame, int frame_time) {
     // Draws the screen during Sandbox mode
     // ----------------------------------------------------------
-    // active_shape: The shape the player is currently controlling
-    // previous_shapes: Array of all previously-placed shapes
-    // menu_open: Toggles whether or not the toolbar is visible
-    // menu_item: The currently-selected toolbar item
-    // sandbox_lock: Whether or not shape-locking is active
-    // quit_dialog_active: Whether or not the "are you sure?" dialog box is open
-    // quit_dialog_selected: Selection of yes-or-no in the "are you sure?" dialog box
+    // frame: everything to be drawn (see sandbox_frame in frame.h)
 
     int time = SDL_GetTicks();
 
@@ -2151,7 +2532,7 @@ bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_o
 
     // sets up a dummy bgdata
     bg_data bg_data = {
-        time,
+        (float)time,
         0,
         false,
         false,
@@ -2166,40 +2547,23 @@ bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_o
 
     SDL_Rect grid_area = get_grid_shape_area(width/2, height/2, height/22);
 
-    // all shapes are rendered to a texture in order to allow for "erase" colors to function
-    SDL_Texture *shape_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, grid_area.w, grid_area.w);
-    SDL_SetRenderTarget(renderer, shape_texture);
-
-    // clear out any garbage data that the texture might have
-    // fixes a very nasty feedback loop bug in "real" fullscreen
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-    SDL_RenderClear(renderer);
+    // placed shapes go through the shape layer (see draw_shape_layer()), with the shape being moved around on top
+    // a translucent shape (e.g. one in the erase color) has to cut through the placed ones, though, so it goes on the layer with them
+    // the layer's then redrawn whenever it moves, which only happens while it's translucent
+    SDL_Color active_color = get_color(frame.active_shape.color);
 
-    for (int i = 0; i < previous_shapes.size(); i++) {
-        draw_shape(
-            previous_shapes[i].type,
-            previous_shapes[i].x,
-            previous_shapes[i].y,
-            previous_shapes[i].scale,
-            get_color(previous_shapes[i].color),
-            0, 0, grid_area.w/15);
-    }
-
-    draw_shape(
-        active_shape.type,
-        active_shape.x,
-        active_shape.y,
-        active_shape.scale,
-        get_color(active_shape.color),
-        0, 0, grid_area.w/15);
-
-    SDL_SetTextureBlendMode(shape_texture, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderTarget(renderer, NULL);
-    SDL_RenderCopy(renderer, shape_texture, NULL, &grid_area);
-    SDL_DestroyTexture(shape_texture);
+    if (active_color.a < 255 && frame.active_shape.type != -1) {
+        static vector<shape> layer_shapes;
+        layer_shapes.assign(frame.previous_shapes->begin(), frame.previous_shapes->end());
+        layer_shapes.push_back(frame.active_shape);
+        draw_shape_layer(layer_shapes, grid_area);
+    } else {
+        draw_shape_layer(*frame.previous_shapes, grid_area);
+        draw_grid_shape(frame.active_shape, active_color, grid_area);
+    }
 
     // draws the sandbox menu (if it's open)
-    if (menu_open) {
+    if (frame.menu_open) {
         SDL_Rect icon_area;
         SDL_Rect icon_coords;
         int icon_tex_size;
@@ -2212,7 +2576,7 @@ bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_o
         // draws the sandbox icons and boxes
         for (int i = 0; i < sandbox_item_count; i++) {
             Uint8 shade = 96;
-            if (i == menu_item) {shade = (abs(sin(time*0.4/90)) * 30) + 220;}
+            if (i == frame.menu_item) {shade = (abs(sin(time*0.4/90)) * 30) + 220;}
 
             icon_area.x = (i * (icon_size + icon_padding)) + (width/2 - total_width_of_icons/2);
             icon_area.y = height - icon_size - (icon_padding/2);
@@ -2240,7 +2604,7 @@ bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_o
 
             SDL_RenderCopy(renderer, sandbox_icon_texture, &icon_coords, &icon_area);
 
-            if (i == 5 && sandbox_lock) {
+            if (i == 5 && frame.sandbox_lock) {
                 SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_MOD);
                 SDL_SetRenderDrawColor(renderer, 64, 64, 255, 255);
                 SDL_RenderFillRect(renderer, &icon_area);
@@ -2248,17 +2612,17 @@ bool draw_sandbox(shape active_shape, vector<shape> previous_shapes, bool menu_o
             }
         }
 
-        draw_text(get_lang_string(sandbox_items[menu_item]), width/2, height - icon_size - icon_padding - font->h, 1, 0);
+        draw_text(get_lang_string(sandbox_items[frame.menu_item]), width/2, height - icon_size - icon_padding - font->h, 1, 0);
     }
 
     // draws the "are you sure?" dialog box
-    if (quit_dialog_active) {
+    if (frame.quit_dialog_active) {
         int char_height = font->h;
         int scale_mul = fmax(floor(fmin(height, width)/360), 1);
         SDL_Color text_color_1 = {255, 255, 96};
         SDL_Color text_color_2 = {96, 96, 96};
 
-        if (quit_dialog_selected) {
+        if (frame.quit_dialog_selected) {
             SDL_Color temp = text_color_1;
             text_color_1 = text_color_2;
             text_color_2 = temp;
@@ -2332,20 +2696,22 @@ bool draw_tutorial(int frame_time) {
 
     switch (get_tutorial_state()) {
         case TUT_FACE:
-            draw_shape(0, 7, 7, 7,  {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
-            draw_shape(0, 3, 6, 2,  {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
-            draw_shape(0, 11, 6, 2, {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
-            draw_shape(0, 7, 10, 3, {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
-            draw_shape(0, 7, 9, 3,  {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            queue_shape(0, 7, 7, 7,  {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            queue_shape(0, 3, 6, 2,  {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
+            queue_shape(0, 11, 6, 2, {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
+            queue_shape(0, 7, 10, 3, {0, 0, 0, 255},       grid_w, grid_h, grid_scale);
+            queue_shape(0, 7, 9, 3,  {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            draw_queued_shapes();
             break;
 
         case TUT_SHAPES:
             draw_shape_outline(0, -3, 7, 6, get_rainbow_color(time), grid_w, grid_h + (sin(time/400.f) * (height/32)), grid_scale);
             draw_shape_outline(1, 7, 7, 6, get_rainbow_color(time+200), grid_w, grid_h + (sin(time/400.f + 400) * (height/32)), grid_scale);
             draw_shape_outline(2, 17, 7, 6, get_rainbow_color(time+400), grid_w, grid_h + (sin(time/400.f + 800) * (height/32)), grid_scale);
-            draw_shape(0, -3, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
-            draw_shape(1, 7, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
-            draw_shape(2, 17, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            queue_shape(0, -3, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            queue_shape(1, 7, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            queue_shape(2, 17, 7, 4, {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+            draw_queued_shapes();
             break;
 
         case TUT_GRID_TYPE:
@@ -2412,6 +2778,51 @@ bool draw_tutorial(int frame_time) {
         draw_text(message_list[iteration], 0, (height - (font->h * scale_mul * message_list.size())) + (font->h * scale_mul * iteration) - 16, scale_mul, 1);
     }
 
+    draw_fade(16, 16, frame_time);
+    return true;
+}
+
+bool draw_calibration(double ticks, int frame_time) {
+    // Draws the audio calibration screen
+    // ----------------------------------------------------------
+    // See calibration.cpp for more info!
+    // ticks: the song clock with the audio offset taken off, so the pulse lines up with the clicks once calibrated
+
+    int scale_mul = fmax(floor(fmin(height, width)/360), 1);
+    int char_height = font->h * scale_mul;
+    int grid_scale = height/22;
+    int grid_w = width/2 - (grid_scale * 7.5);
+    int grid_h = height/2 - (grid_scale * 7.5);
+
+    // goes from 0 to 1 over the course of each click
+    double interval = get_calibration_interval();
+    double beat_progress = fmod(fmax(ticks, 0), interval) / interval;
+
+    draw_gradient(0, 0, width, height, {255, 160, 32});
+    draw_menu_background(frame_time);
+
+    // pulses on every click
+    draw_shape(0, 7, 7, 6 - fmin(beat_progress * 8, 3), {255, 255, 255, 255}, grid_w, grid_h, grid_scale);
+
+    draw_text(get_lang_string("calibration.header"), width/2, height/16, scale_mul * 2, 0);
+
+    if (check_calibration_finished()) {
+        char result[64];
+        snprintf(result, sizeof(result), "%+.0f ms (+/- %.1f ms)", get_calibration_offset(), get_calibration_deviation());
+
+        draw_text(get_lang_string("calibration.result") + ": " + result, width/2, height - (char_height * 3), scale_mul, 0, width, {255, 255, 96});
+        draw_text(get_lang_string("calibration.accept"), width/2, height - (char_height * 2), scale_mul, 0);
+    } else {
+        string taps = get_lang_string("calibration.taps") + ": " + to_string(get_calibration_tap_count()) + " / " + to_string(get_calibration_tap_target());
+
+        draw_text(get_lang_string("calibration.instructions"), width/2, height - (char_height * 3), scale_mul, 0);
+        draw_text(taps, width/2, height - (char_height * 2), scale_mul, 0);
+    }
+
+    if (get_audio_underruns() > 0) {
+        draw_text(get_lang_string("calibration.underruns"), width/2, height/16 + (char_height * 2), scale_mul, 0, width, {255, 96, 96});
+    }
+
     draw_fade(16, 16, frame_time);
     return true;
 }
\ No newline at end of file
@@ -1,29 +1,30 @@
 #pragma once
 
 #include "background.h"
-
-// dedicated struct for a shape, cleaner and faster than using JSON arrays
-struct shape {
-    int type;
-    int x;
-    int y;
-    int scale;
-    int color;
-};
+#include "core.h"
+#include "frame.h"
 
 SDL_Color get_color(int);
+SDL_Color get_default_color(int);
+bool check_hex_string(std::string);
+SDL_Color hex_string_to_color(std::string);
 void reset_color_table();
 void set_color_table(int, std::string);
+void set_color_table(int, SDL_Color);
 void set_combo_timer(int);
 
 void draw_gradient(int, int, int, int, SDL_Color);
 void draw_text(std::string, int, int, int, int, int, SDL_Color = {255, 255, 255});
 void draw_grid(int, int, int, SDL_Color, bool);
-void draw_fps(bool, int, int);
+void draw_fps(bool, int, double, double);
 void draw_fade(int, int, int);
 void draw_level_intro_fade(int, int, int);
+void reset_shape_layer();
+void reset_shape_atlas();
 
 void init_background_effect();
+void init_background_effect(background_effect);
+void reload_background_tileset();
 void draw_background_effect(bg_data, bool, int);
 void draw_menu_background(int);
 
@@ -42,8 +43,9 @@ void draw_loading(bool = false);
 bool draw_warning(int);
 bool draw_title(int, int);
 bool draw_credits(int);
-bool draw_level_select(std::vector<shape>, int);
-bool draw_game(int, int, int, int, float, int, int, bool, bool, shape, shape, std::vector<shape>, bool, bool, bool, bool, bool, int);
+bool draw_level_select(const std::vector<shape>&, int);
+bool draw_game(const game_frame&, int);
 bool draw_options(int);
-bool draw_sandbox(shape, std::vector<shape>, bool, bool, int, bool, bool, int);
-bool draw_tutorial(int);
\ No newline at end of file
+bool draw_sandbox(const sandbox_frame&, int);
+bool draw_tutorial(int);
+bool draw_calibration(double, int);
\ No newline at end of file
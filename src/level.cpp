@@ -0,0 +1,685 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core.h"
+#include "level.h"
+
+using std::string;
+using std::vector;
+using json = nlohmann::json;
+
+// compiled level files (.omlvl)
+// these hold everything parse_level_file() would otherwise have to work out from level.json, already validated,
+// so loading one is just a matter of mapping it into memory and copying the values out
+// every number is little-endian; the layout goes as follows:
+// ----------------------------------------------------------
+// header: "OMLV", u16 version, u16 bpm, u8 time_signature_top, u8 time_signature_bottom, u16 offset, u8 bg_color, u16 shape count
+// palette: 16 colors, 4 bytes each (RGBA)
+// strings: name, genre, level_author, song_author and background_effect, each NUL-terminated
+// shapes: for each shape...
+//   u8 type, u8 x, u8 y, u8 scale, u8 color, u16 song_step, u16 auto_shape count
+//   the sequence, two ops per byte (see level_ops); the first op is in the low nibble
+//   the auto_shapes, 5 bytes each (type, x, y, scale, color)
+
+const char level_magic[4] = {'O', 'M', 'L', 'V'};
+const int level_version = 1;
+
+// every op a sequence can contain, in the order they're numbered in the file
+const char level_ops[] = ".ZXCVASUDLR";
+
+// reads level.json in a single pass through nlohmann's SAX interface, filling in a level_source as each value comes in
+// no JSON document is built along the way, and anything the game doesn't use is skipped over
+// like with json::value(), anything that's missing or the wrong type keeps its default
+enum level_sax_context {
+    SAX_ROOT,           // the level itself, an array of the header followed by each shape
+    SAX_HEADER,
+    SAX_COLOR_TABLE,
+    SAX_SHAPE,
+    SAX_AUTO_SHAPES,
+    SAX_AUTO_SHAPE,
+    SAX_SKIP            // anything we don't care about, including everything inside it
+};
+
+struct level_sax_handler : json::json_sax_t {
+    level_source &source;
+    vector<level_sax_context> contexts;
+    std::string current_key;
+    int root_index = 0;
+    int color_index = 0;
+    int bg_color = -1;
+    int legacy_bg_color = -1;
+    std::string error;
+
+    level_sax_handler(level_source &source) : source(source) {}
+
+    level_sax_context get_context() {
+        return contexts.empty() ? SAX_SKIP : contexts.back();
+    }
+
+    void set_shape_value(shape &s, int value) {
+        if (current_key == "shape") {s.type = value;}
+        if (current_key == "x") {s.x = value;}
+        if (current_key == "y") {s.y = value;}
+        if (current_key == "scale") {s.scale = value;}
+        if (current_key == "color") {s.color = value;}
+        return;
+    }
+
+    bool set_number(int value) {
+        switch (get_context()) {
+            case SAX_ROOT: root_index++; break;
+
+            case SAX_HEADER:
+                if (current_key == "bpm") {source.info.bpm = value;}
+                if (current_key == "time_signature_top") {source.info.time_signature_top = value;}
+                if (current_key == "time_signature_bottom") {source.info.time_signature_bottom = value;}
+                if (current_key == "offset") {source.offset = value;}
+                if (current_key == "bg_color") {bg_color = value;}
+                if (current_key == "bgColor") {legacy_bg_color = value;}
+                break;
+
+            case SAX_SHAPE:
+                set_shape_value(source.shapes.back().target, value);
+                if (current_key == "song_step") {source.shapes.back().song_step = value;}
+                break;
+
+            case SAX_AUTO_SHAPE: set_shape_value(source.shapes.back().auto_shapes.back(), value); break;
+            case SAX_COLOR_TABLE: set_color(""); break;
+            default: break;
+        }
+
+        return true;
+    }
+
+    bool set_string(const std::string &value) {
+        switch (get_context()) {
+            case SAX_ROOT: root_index++; break;
+
+            case SAX_HEADER:
+                if (current_key == "name") {source.info.name = value;}
+                if (current_key == "genre") {source.info.genre = value;}
+                if (current_key == "level_author") {source.info.level_author = value;}
+                if (current_key == "song_author") {source.info.song_author = value;}
+                if (current_key == "background_effect") {source.info.background_effect = value;}
+                break;
+
+            case SAX_SHAPE:
+                if (current_key == "sequence") {
+                    source.shapes.back().sequence = value;
+                    source.shapes.back().has_sequence = true;
+                }
+                break;
+
+            case SAX_COLOR_TABLE: set_color(value); break;
+            default: break;
+        }
+
+        return true;
+    }
+
+    bool set_other() {
+        // nulls and bools; the only place these count for anything is the color table, where a bool is a malformed color
+        if (get_context() == SAX_ROOT) {root_index++;}
+        return true;
+    }
+
+    void set_color(const std::string &value) {
+        // non-string colors are stored as an empty string, so they get reported as malformed
+        if (color_index < 16) {
+            source.color_table[color_index] = value;
+            source.color_table_set[color_index] = true;
+        }
+
+        color_index++;
+        return;
+    }
+
+    bool null() override {
+        if (get_context() == SAX_COLOR_TABLE) {color_index++;}
+        return set_other();
+    }
+
+    bool boolean(bool) override {
+        if (get_context() == SAX_COLOR_TABLE) {set_color("");}
+        return set_other();
+    }
+
+    bool number_integer(number_integer_t value) override {return set_number(value);}
+    bool number_unsigned(number_unsigned_t value) override {return set_number(value);}
+    bool number_float(number_float_t value, const string_t&) override {return set_number(value);}
+    bool string(string_t &value) override {return set_string(value);}
+    bool binary(binary_t&) override {return set_other();}
+
+    bool start_object(std::size_t) override {
+        level_sax_context context = SAX_SKIP;
+
+        if (contexts.empty()) {
+            error = "Level must be an array.";
+            return false;
+        }
+
+        switch (get_context()) {
+            case SAX_ROOT:
+                if (root_index == 0) {
+                    context = SAX_HEADER;
+                } else {
+                    context = SAX_SHAPE;
+                    source.shapes.push_back(level_shape_entry());
+                }
+
+                root_index++;
+                break;
+
+            case SAX_AUTO_SHAPES:
+                context = SAX_AUTO_SHAPE;
+                source.shapes.back().auto_shapes.push_back({0, 7, 7, 1, 0});
+                break;
+
+            // a whole object counts as one malformed color; whatever's inside it is skipped
+            case SAX_COLOR_TABLE: set_color(""); break;
+            default: break;
+        }
+
+        contexts.push_back(context);
+        return true;
+    }
+
+    bool end_object() override {
+        contexts.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        level_sax_context context = SAX_SKIP;
+
+        if (contexts.empty()) {context = SAX_ROOT;}
+        if (get_context() == SAX_ROOT) {root_index++;}
+        if (get_context() == SAX_COLOR_TABLE) {set_color("");}
+        if (get_context() == SAX_HEADER && current_key == "color_table") {context = SAX_COLOR_TABLE; color_index = 0;}
+        if (get_context() == SAX_SHAPE && current_key == "auto_shapes") {context = SAX_AUTO_SHAPES;}
+
+        contexts.push_back(context);
+        return true;
+    }
+
+    bool end_array() override {
+        contexts.pop_back();
+        return true;
+    }
+
+    bool key(string_t &value) override {
+        current_key = value;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception &err) override {
+        error = err.what();
+        return false;
+    }
+};
+
+bool finish_level_source(level_sax_handler &handler, level_source &source, string &error) {
+    // fills in whatever depends on more than one value, once the whole level's been read
+    if (handler.root_index == 0) {
+        error = "Level is empty.";
+        return false;
+    }
+
+    // "bgColor" is a legacy/deprecated property, and should not be used anymore; bg_color (the newer one) has higher priority
+    if (handler.legacy_bg_color != -1) {source.info.bg_color = handler.legacy_bg_color;}
+    if (handler.bg_color != -1) {source.info.bg_color = handler.bg_color;}
+
+    source.info.measure_length = source.info.time_signature_top * source.info.time_signature_bottom;
+
+    return true;
+}
+
+bool parse_level_stream(std::istream &stream, level_source &source, string &error) {
+    // reads a level.json from stream into source; returns false (with the reason in error) if it isn't valid
+    source = level_source();
+    level_sax_handler handler(source);
+
+    if (!json::sax_parse(stream, &handler)) {
+        error = handler.error;
+        return false;
+    }
+
+    return finish_level_source(handler, source, error);
+}
+
+bool parse_level_data(const unsigned char *data, size_t size, level_source &source, string &error) {
+    // same as above, but for a level.json that's already in memory (e.g. inside a level pack)
+    source = level_source();
+    level_sax_handler handler(source);
+
+    if (!json::sax_parse(data, data + size, &handler)) {
+        error = handler.error;
+        return false;
+    }
+
+    return finish_level_source(handler, source, error);
+}
+
+void compile_level_schedule(const level_source &level, level_schedule &schedule) {
+    // flattens a level read by parse_level_stream() into the schedule used during gameplay (see core.h)
+    // this way, core_step() only ever has to index into arrays instead of looking anything up in the level
+    // ----------------------------------------------------------
+    // level: a level that's already been through parse_level_file(), so all sequences are present and the right length
+
+    int measure_length = level.info.measure_length;
+    int size = level.shapes.size() + 1;
+
+    schedule.bpm = level.info.bpm;
+    schedule.time_signature_top = level.info.time_signature_top;
+    schedule.time_signature_bottom = level.info.time_signature_bottom;
+    schedule.measure_length = measure_length;
+    schedule.start_offset = level.offset == -1 ? measure_length * 2 : level.offset;
+    schedule.total_shapes = size - 1;
+    schedule.beat_length_seconds = (60.f/schedule.bpm * 2.f) / schedule.time_signature_bottom;
+
+    schedule.cpu_ops.assign(size * measure_length, '.');
+    schedule.colors.assign(size, 0);
+    schedule.song_steps.assign(size, measure_length * 2);
+    schedule.auto_shape_start.assign(size + 1, 0);
+    schedule.auto_shapes.clear();
+
+    for (int i = 1; i < size; i++) {
+        const level_shape_entry &entry = level.shapes[i - 1];
+        string sequence = entry.has_sequence ? entry.sequence : ".";
+        sequence.copy(&schedule.cpu_ops[i * measure_length], measure_length);
+
+        schedule.colors[i] = entry.target.color;
+        if (entry.song_step != -1) {schedule.song_steps[i] = entry.song_step;}
+        schedule.auto_shape_start[i] = schedule.auto_shapes.size();
+        schedule.auto_shapes.insert(schedule.auto_shapes.end(), entry.auto_shapes.begin(), entry.auto_shapes.end());
+    }
+
+    schedule.auto_shape_start[size] = schedule.auto_shapes.size();
+    compile_beat_flags(schedule);
+
+    return;
+}
+
+void put_u8(vector<unsigned char> &out, int value) {
+    out.push_back(value & 0xFF);
+    return;
+}
+
+void put_u16(vector<unsigned char> &out, int value) {
+    out.push_back(value & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    return;
+}
+
+bool check_range(int value, int min, int max, const char *name) {
+    if (value >= min && value <= max) {return true;}
+
+    printf("[!] Couldn't compile level: %s is out of range (%i).\n", name, value);
+    return false;
+}
+
+bool put_shape(vector<unsigned char> &out, shape s) {
+    // shapes have to fit on the grid, the same as get_shape_state() (see core.cpp) and the renderer expect
+    if (!check_range(s.type, 0, 2, "shape") || !check_range(s.x, 0, 14, "x") || !check_range(s.y, 0, 14, "y")) {return false;}
+    if (!check_range(s.scale, 1, 8, "scale") || !check_range(s.color, 0, 16, "color")) {return false;}
+
+    put_u8(out, s.type);
+    put_u8(out, s.x);
+    put_u8(out, s.y);
+    put_u8(out, s.scale);
+    put_u8(out, s.color);
+    return true;
+}
+
+bool compile_level_file(const level_source &level, const unsigned char palette[16][4], const string &path) {
+    // writes a compiled copy of a level to path
+    // ----------------------------------------------------------
+    // level: a level that's already been through parse_level_file(), so all sequences are present and the right length
+    // palette: the level's color table, after any color_table overrides have been applied
+
+    level_schedule schedule;
+    const level_info &info = level.info;
+    compile_level_schedule(level, schedule);
+
+    int ml = schedule.measure_length;
+    int bg_color = info.bg_color;
+
+    if (!check_range(schedule.bpm, 1, 65535, "bpm") || !check_range(schedule.time_signature_top, 1, 255, "time_signature_top")) {return false;}
+    if (!check_range(schedule.time_signature_bottom, 1, 255, "time_signature_bottom") || !check_range(schedule.start_offset, 0, 65535, "offset")) {return false;}
+    if (!check_range(bg_color, 0, 16, "bg_color") || !check_range(schedule.total_shapes, 0, 65535, "shape count")) {return false;}
+
+    vector<unsigned char> out;
+    out.insert(out.end(), level_magic, level_magic + 4);
+    put_u16(out, level_version);
+    put_u16(out, schedule.bpm);
+    put_u8(out, schedule.time_signature_top);
+    put_u8(out, schedule.time_signature_bottom);
+    put_u16(out, schedule.start_offset);
+    put_u8(out, bg_color);
+    put_u16(out, schedule.total_shapes);
+
+    for (int i = 0; i < 16; i++) {
+        out.insert(out.end(), palette[i], palette[i] + 4);
+    }
+
+    for (const string *value: {&info.name, &info.genre, &info.level_author, &info.song_author, &info.background_effect}) {
+        out.insert(out.end(), value->begin(), value->end());
+        out.push_back(0);
+    }
+
+    for (int i = 1; i <= level.shapes.size(); i++) {
+        int auto_count = schedule.auto_shape_start[i + 1] - schedule.auto_shape_start[i];
+
+        if (!put_shape(out, level.shapes[i - 1].target)) {return false;}
+        if (!check_range(schedule.song_steps[i], 0, 65535, "song_step")) {return false;}
+
+        put_u16(out, schedule.song_steps[i]);
+        put_u16(out, auto_count);
+
+        // packs the sequence two ops to a byte
+        for (int j = 0; j < ml; j += 2) {
+            int packed = 0;
+
+            for (int k = 0; k < 2 && j + k < ml; k++) {
+                const char *op = strchr(level_ops, schedule.cpu_ops[i * ml + j + k]);
+
+                if (op == NULL || *op == '\0') {
+                    printf("[!] Couldn't compile level: Sequence #%i has an unknown op (%c).\n", i, schedule.cpu_ops[i * ml + j + k]);
+                    return false;
+                }
+
+                packed |= (op - level_ops) << (k * 4);
+            }
+
+            put_u8(out, packed);
+        }
+
+        for (int j = 0; j < auto_count; j++) {
+            if (!put_shape(out, level.shapes[i - 1].auto_shapes[j])) {return false;}
+        }
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+
+    if (file == NULL) {
+        printf("[!] Couldn't write compiled level: %s\n", path.c_str());
+        return false;
+    }
+
+    bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+
+    if (!written) {
+        printf("[!] Couldn't write compiled level: %s\n", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool map_level_file(const string &path, mapped_level &level) {
+    // maps a compiled level into memory (read-only); free it with unmap_level_file() once it's been read
+    level = {NULL, 0};
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {return false;}
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {return false;}
+
+    // the view keeps the mapping alive on its own, so the handle can be closed straight away
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) {return false;}
+
+    level = {(const unsigned char*) data, (size_t) size.QuadPart};
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file == -1) {return false;}
+
+    struct stat info;
+    if (fstat(file, &info) == -1 || info.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {return false;}
+
+    level = {(const unsigned char*) data, (size_t) info.st_size};
+#endif
+
+    return true;
+}
+
+void unmap_level_file(mapped_level &level) {
+    if (level.data == NULL) {return;}
+
+#ifdef _WIN32
+    UnmapViewOfFile(level.data);
+#else
+    munmap((void*) level.data, level.size);
+#endif
+
+    level = {NULL, 0};
+    return;
+}
+
+// keeps track of where read_level_file() is in the file; every read is bounds-checked against the end
+struct level_reader {
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+    bool failed;
+};
+
+int get_u8(level_reader &reader) {
+    if (reader.pos + 1 > reader.size) {
+        reader.failed = true;
+        return 0;
+    }
+
+    return reader.data[reader.pos++];
+}
+
+int get_u16(level_reader &reader) {
+    int low = get_u8(reader);
+    int high = get_u8(reader);
+    return low | (high << 8);
+}
+
+string get_string(level_reader &reader) {
+    const void *end = reader.pos < reader.size ? memchr(reader.data + reader.pos, 0, reader.size - reader.pos) : NULL;
+
+    if (end == NULL) {
+        reader.failed = true;
+        return "";
+    }
+
+    string value((const char*) reader.data + reader.pos, (const unsigned char*) end - (reader.data + reader.pos));
+    reader.pos += value.length() + 1;
+    return value;
+}
+
+bool check_read_range(level_reader &reader, int value, int min, int max, const char *name) {
+    // the same limits compile_level_file() puts on a level apply when reading one, so a damaged file can't hand out-of-range values to the game
+    if (reader.failed || (value >= min && value <= max)) {return true;}
+
+    printf("[!] Couldn't read compiled level: %s is out of range (%i).\n", name, value);
+    reader.failed = true;
+    return false;
+}
+
+shape get_shape(level_reader &reader) {
+    shape s;
+    s.type = get_u8(reader);
+    s.x = get_u8(reader);
+    s.y = get_u8(reader);
+    s.scale = get_u8(reader);
+    s.color = get_u8(reader);
+
+    // see put_shape(); only the first bad value gets reported, since the reader's marked as failed after it
+    check_read_range(reader, s.type, 0, 2, "shape");
+    check_read_range(reader, s.x, 0, 14, "x");
+    check_read_range(reader, s.y, 0, 14, "y");
+    check_read_range(reader, s.scale, 1, 8, "scale");
+    check_read_range(reader, s.color, 0, 16, "color");
+    return s;
+}
+
+bool read_level_file(const mapped_level &level, level_info &info, vector<shape> &preview_shapes, unsigned char palette[16][4], level_schedule &schedule) {
+    // reads a mapped compiled level; nothing points back into the mapping afterwards, so it can be unmapped right away
+    // ----------------------------------------------------------
+    // info: filled in with the level's metadata
+    // preview_shapes: every shape and auto-shape in order, for the level select preview
+    // palette: the level's color table
+    // schedule: the same schedule compile_level_schedule() would've produced from the original level
+
+    level_reader reader = {level.data, level.size, 0, false};
+
+    if (level.size < 4 || memcmp(level.data, level_magic, 4) != 0) {
+        printf("[!] Couldn't read compiled level: Not a compiled level.\n");
+        return false;
+    }
+
+    reader.pos = 4;
+
+    if (get_u16(reader) != level_version) {
+        printf("[!] Couldn't read compiled level: Unsupported version.\n");
+        return false;
+    }
+
+    int bpm = get_u16(reader);
+    int top = get_u8(reader);
+    int bot = get_u8(reader);
+    int offset = get_u16(reader);
+    int bg_color = get_u8(reader);
+    int total_shapes = get_u16(reader);
+    int ml = top * bot;
+
+    check_read_range(reader, bg_color, 0, 16, "bg_color");
+
+    if (reader.failed || bpm == 0 || ml == 0) {
+        printf("[!] Couldn't read compiled level: Header is invalid.\n");
+        return false;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 4; j++) {palette[i][j] = get_u8(reader);}
+    }
+
+    info.bpm = bpm;
+    info.time_signature_top = top;
+    info.time_signature_bottom = bot;
+    info.measure_length = ml;
+    info.bg_color = bg_color;
+
+    for (string *value: {&info.name, &info.genre, &info.level_author, &info.song_author, &info.background_effect}) {
+        *value = get_string(reader);
+    }
+
+    int size = total_shapes + 1;
+
+    schedule.bpm = bpm;
+    schedule.time_signature_top = top;
+    schedule.time_signature_bottom = bot;
+    schedule.measure_length = ml;
+    schedule.start_offset = offset;
+    schedule.total_shapes = total_shapes;
+    schedule.beat_length_seconds = (60.f/bpm * 2.f) / bot;
+
+    schedule.cpu_ops.assign(size * ml, '.');
+    schedule.colors.assign(size, 0);
+    schedule.song_steps.assign(size, ml * 2);
+    schedule.auto_shape_start.assign(size + 1, 0);
+    schedule.auto_shapes.clear();
+    preview_shapes.clear();
+
+    for (int i = 1; i < size && !reader.failed; i++) {
+        shape s = get_shape(reader);
+        preview_shapes.push_back(s);
+
+        schedule.colors[i] = s.color;
+        schedule.song_steps[i] = get_u16(reader);
+        schedule.auto_shape_start[i] = schedule.auto_shapes.size();
+
+        int auto_count = get_u16(reader);
+
+        for (int j = 0; j < ml; j += 2) {
+            int packed = get_u8(reader);
+
+            for (int k = 0; k < 2 && j + k < ml; k++) {
+                int op = (packed >> (k * 4)) & 0xF;
+
+                if (op >= strlen(level_ops)) {
+                    reader.failed = true;
+                    break;
+                }
+
+                schedule.cpu_ops[i * ml + j + k] = level_ops[op];
+            }
+        }
+
+        for (int j = 0; j < auto_count && !reader.failed; j++) {
+            s = get_shape(reader);
+            schedule.auto_shapes.push_back(s);
+            preview_shapes.push_back(s);
+        }
+    }
+
+    if (reader.failed) {
+        printf("[!] Couldn't read compiled level: File is truncated or corrupt.\n");
+        return false;
+    }
+
+    schedule.auto_shape_start[size] = schedule.auto_shapes.size();
+    compile_beat_flags(schedule);
+
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "core.h"
+
+// a level's metadata (the first object in level.json), read once when the level's loaded
+// defaults are the same ones the game has always fallen back on when a key is missing
+struct level_info {
+    std::string name = "Untitled";
+    std::string genre = "Unknown";
+    std::string level_author = "Anonymous";
+    std::string song_author = "Anonymous";
+    std::string background_effect = "none";
+    int bpm = 120;
+    int time_signature_top = 4;
+    int time_signature_bottom = 4;
+    int measure_length = 16;
+    int bg_color = 15;
+};
+
+// a shape as written in level.json
+// has_sequence: false if the level didn't give one, in which case one has to be generated
+// song_step: -1 if the level didn't give one
+struct level_shape_entry {
+    shape target = {0, 7, 7, 1, 0};
+    std::string sequence;
+    bool has_sequence = false;
+    int song_step = -1;
+    std::vector<shape> auto_shapes;
+};
+
+// a whole level as written in level.json, read by parse_level_stream()
+// offset: -1 if the level didn't give one
+// color_table: the level's color table overrides; color_table_set is false for any that weren't given (or were null)
+struct level_source {
+    level_info info;
+    int offset = -1;
+    std::string color_table[16];
+    bool color_table_set[16] = {};
+    std::vector<level_shape_entry> shapes;
+};
+
+bool parse_level_stream(std::istream&, level_source&, std::string&);
+bool parse_level_data(const unsigned char*, size_t, level_source&, std::string&);
+void compile_level_schedule(const level_source&, level_schedule&);
+
+// compiled levels (.omlvl); see level.cpp for the file layout
+
+// a compiled level that's been mapped into memory
+struct mapped_level {
+    const unsigned char *data = NULL;
+    size_t size = 0;
+};
+
+bool compile_level_file(const level_source&, const unsigned char[16][4], const std::string&);
+bool map_level_file(const std::string&, mapped_level&);
+void unmap_level_file(mapped_level&);
+bool read_level_file(const mapped_level&, level_info&, std::vector<shape>&, unsigned char[16][4], level_schedule&);
@@ -30,6 +30,13 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <unordered_set>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -37,9 +44,15 @@
 #include <nlohmann/json.hpp>
 
 #include "graphics.h"
+#include "core.h"
 #include "character.h"
 #include "options.h"
 #include "tutorial.h"
+#include "calibration.h"
+#include "level.h"
+#include "pack.h"
+#include "watcher.h"
+#include "timing.h"
 #include "version.h"
 
 using nlohmann::json;
@@ -121,6 +134,18 @@ const json language_fallback = json::object({
     {"options.audio.music.desc",            "Controls the volume of music."},
     {"options.audio.sfx.desc",              "Controls the volume of sound effects."},
     {"options.audio.speaker.desc",          "Controls the number of audio channels to output to."},
+    {"options.audio.offset",                "Audio Offset"},
+    {"options.audio.calibrate",             "Calibrate Offset"},
+    {"options.audio.buffer",                "Audio Buffer Size"},
+    {"options.audio.offset.desc",           "Compensates for audio delay when judging inputs and drawing beats."},
+    {"options.audio.calibrate.desc",        "Measures the audio offset by tapping along to a click track."},
+    {"options.audio.buffer.desc",           "Smaller buffers lower latency, but may crackle. Applies after a restart."},
+    {"calibration.header",                  "Calibration"},
+    {"calibration.instructions",            "Tap any button along with the clicks."},
+    {"calibration.taps",                    "Taps"},
+    {"calibration.result",                  "Audio Offset"},
+    {"calibration.accept",                  "Press Start to save this offset, or Back to cancel."},
+    {"calibration.underruns",               "Audio underruns detected; try a bigger audio buffer."},
     {"options.controls.rebind.kb",          "Rebind Keyboard"},
     {"options.controls.rebind.ctrl",        "Rebind Controller"},
     {"options.controls.reset.kb",           "Reset Keyboard Binds"},
@@ -185,6 +210,8 @@ extern int sandbox_item_count;
 extern int music_volume;
 extern int sfx_volume;
 extern bool mono_toggle;
+extern int audio_offset;
+extern int audio_buffer_size;
 extern int frame_cap;
 extern bool fps_toggle;
 extern bool fullscreen_toggle;
@@ -196,11 +223,7 @@ extern bool blindfold_toggle;
 extern bool rumble_toggle;
 extern int controller_index;
 bool debug_toggle;
-
-// main-game variables
-int score = 0;
-int combo = 0;
-int life = 100;
+bool software_shapes_toggle;
 
 // metadata storage for level select
 struct {
@@ -214,21 +237,16 @@ struct {
 bool beat_advanced = false;
 bool shape_advanced = false;
 
-// timekeeping flags (and some other data)
-float beat_start_time;
-float length;
+// timekeeping (the rest lives in game, see below)
 int bpm = 120;
-int beat_count = 0;
-int song_beat_position = 0;
 int song_start_time;
 int intro_beat_length;
-string cpu_sequence;
-string player_sequence;
-bool song_over = false;
-bool game_over = false;
+
+// set by the simulation; the render thread picks these up from the snapshot
+bool combo_triggered = false;
 
 // used only in main(); stored globally so it can be modified by options.cpp
-int frame_cap_ms = (1000 / frame_cap);
+double frame_cap_ms = (1000.0 / frame_cap);
 
 // sound effects
 Mix_Chunk *snd_menu_move;
@@ -253,25 +271,126 @@ Mix_Chunk *snd_combo;
 // the music track that's playing
 Mix_Music *music;
 
+// the stage's song, fully decoded into memory and played through stage_music_hook()
+// this makes seeking instant and gapless, since it's just moving stage_song_position
+// if the song can't be decoded, it's streamed through music like any other track instead
+// ----------------------------------------------------------
+// stage_song_position: read position in stage_song->abuf, in bytes
+// stage_song_volume: music volume in SDL's range (0-128), since Mix_VolumeMusic() doesn't affect hooks
+// stage_song_fade_length/stage_song_fade_left: length of the current fade out and how much of it is left, in bytes
+Mix_Chunk *stage_song = NULL;
+SDL_AudioFormat stage_song_format = AUDIO_S16SYS;
+int stage_song_frequency = 44100;
+int stage_song_frame_size = 4;
+std::atomic<Uint32> stage_song_position{0};
+std::atomic<bool> stage_song_playing{false};
+std::atomic<int> stage_song_volume{MIX_MAX_VOLUME};
+std::atomic<int> stage_song_fade_length{0};
+std::atomic<int> stage_song_fade_left{0};
+
 // in addition to actually drawing the fade, these are also used to handle game-state transitions
 extern float fade_in;
 extern float fade_out;
 
 // stores file paths
-vector<string> level_paths;   // e.g. "assets/levels/Foo Bar"
+vector<string> level_paths;   // e.g. "assets/levels/Foo Bar", or "assets/levels/Foo Bar.ompack" for a level pack
 vector<string> level_playlists; // stores playlist names corresponding to level paths, TODO: merge this and level_paths into a single struct
 int level_index = 0;
 
-// contains the currently-loaded JSON level data
-json json_file;
+// false if the currently-selected level couldn't be loaded (see check_level_loaded())
+// the level itself is read out into level_data, previous_shapes and schedule (see apply_parsed_level())
+bool level_loaded = false;
+
+// the currently-loaded level's metadata; read once on load so the get_level_ functions don't have to look it up again
+level_info level_data;
+
+// the pack the current level's assets are read out of, if it's a level pack (see start_level() and open_level_asset())
+level_pack current_pack;
+
+// a level loaded by read_level(), which isn't necessarily the current one (see apply_parsed_level())
+// loaded: false if the level couldn't be loaded
+// source: the level as read from level.json, with its sequences fixed up; not filled in for compiled levels
+// issues: anything that had to be fixed (or couldn't be) while parsing it, as used by the -validate-levels report
+struct parsed_level {
+    bool loaded = false;
+    level_source source;
+    level_info info;
+    vector<shape> preview_shapes;
+    SDL_Color palette[16];
+    level_schedule schedule;
+    json issues = json::array();
+};
+
+// level select loads levels on a worker thread (see run_level_cache()), so scrolling through levels never waits on the disk
+// the selected level is loaded straight away, and its neighbours once the selection has stayed put for level_prefetch_delay ms
+// loaded levels are kept in level_cache (most recently used first), up to level_cache_size of them
+struct cached_level {
+    string path;
+    parsed_level level;
+};
+
+const int level_cache_size = 8;
+const int level_prefetch_delay = 150;
+
+std::list<cached_level> level_cache;
+vector<string> level_requests; // paths the worker still has to load, the selected level first
+string level_request_selected;
+std::chrono::steady_clock::time_point level_request_time;
+std::mutex level_cache_mutex;
+std::condition_variable level_cache_cv;
+std::thread level_cache_thread;
+bool level_cache_running = false;
+bool level_select_pending = false; // true while level select is waiting on the cache for the selected level
+
+// hiscores.json, kept in memory once it's been read (see get_hiscore_data())
+json hiscore_data;
+bool hiscores_loaded = false;
+
+// the currently-loaded level, compiled for use during gameplay (see core.h)
+level_schedule schedule;
+
+// the level being played; only ever advanced through core_step() (see loop())
+core_state game;
+
+// during GAME, gameplay runs on its own thread at a fixed rate (see run_simulation())
+// game_mutex guards all gameplay state while it's running (game, plus the frontend flags set from its events)
+// the render thread never touches that state directly, and instead draws from a snapshot the simulation publishes
+std::thread sim_thread;
+std::atomic<bool> sim_running{false};
+std::mutex game_mutex;
+std::mutex snapshot_mutex;
+const int sim_rate = 1000;
+
+// a copy of the gameplay state for the render thread to draw
+// flags that are only set for a single tick (e.g. beat_advanced) stay set until the render thread takes the snapshot
+struct game_snapshot {
+    int beat_count;
+    double beat_start_time;
+    double beat_length;
+    shape active_shape;
+    shape result_shape;
+    vector<shape> previous_shapes;
+    string cpu_sequence;
+    string player_sequence;
+    int score;
+    int life;
+    int combo;
+    bool song_over;
+    bool game_over;
+    bool beat_advanced;
+    bool shape_advanced;
+    bool combo_triggered;
+    bool level_finished;
+};
+
+game_snapshot published_snapshot;   // written by the simulation thread
+game_snapshot render_snapshot;      // the render thread's copy, see take_snapshot()
 
-// stores current list of shapes and active shape for main game
+// stores current list of shapes and active shape for the sandbox and level select
 // previous_shapes is all the previous shapes in order
-// active shape is the one the CPU/player manipulates
-// result_shape is compared to at the end of a measure to see if a shape matches
+// active shape is the one the player manipulates
 vector<shape> previous_shapes;
 shape active_shape;
-shape result_shape;
 
 // all the possible game states
 enum game_states {
@@ -282,6 +401,7 @@ enum game_states {
     SANDBOX,
     TUTORIAL,
     OPTIONS,
+    CALIBRATION,
     EXIT,
 };
 
@@ -303,6 +423,13 @@ enum controller_buttons {
     SELECT,
 };
 
+// in-game presses, waiting to be judged by the simulation thread (see game_input_watch())
+// this is a single-producer, single-consumer ring buffer: the main thread pushes and the simulation thread pops
+const int input_queue_size = 64;
+core_input input_queue[input_queue_size];
+std::atomic<int> input_queue_head{0};
+std::atomic<int> input_queue_tail{0};
+
 // array that contains SDL keyboard keymap
 // (this should correspond to controller_buttons in terms of order)
 SDL_Keycode keymap[12] = {
@@ -338,6 +465,12 @@ SDL_GameControllerButton buttonmap[12] = {
 // the controller, if one is needed
 SDL_GameController *controller;
 
+// set while the calibration screen is up, so game_input_watch() sends taps there instead
+bool calibration_active = false;
+
+// the last beat drawn during GAME; see get_visual_beat()
+int last_visual_beat_count = 0;
+
 // message of the day string
 string motd = "";
 
@@ -378,7 +511,12 @@ void print_help() {
     "-tf / -true-fullscreen - Enable 'real' fullscreen\n"
     "-v  / -vsync           - Enable V-Sync\n"
     "-d  / -debug           - Enable debug features\n"
-    "-i [FOLDER PATH]       - Specify a level folder to play on start\n");
+    "-ss / -software-shapes - Draw placed shapes in software, instead of on the GPU\n"
+    "-i [FOLDER PATH]       - Specify a level folder to play on start\n"
+    "-compile-level [PATH]  - Compile a level folder into a level.omlvl, then exit\n"
+    "-pack-level [FOLDER]   - Pack a level folder into a single .ompack file, then exit\n"
+    "-validate-levels       - Check every level, write level_report.json, then exit\n"
+    "-validate              - Check every level on startup, writing level_report.json\n");
     return;
 }
 
@@ -388,7 +526,7 @@ void set_fullscreen() {
 }
 
 void set_frame_cap_ms() {
-    frame_cap_ms = (1000 / frame_cap);
+    frame_cap_ms = (1000.0 / frame_cap);
     return;
 }
 
@@ -432,6 +570,7 @@ void save_settings() {
             if (json_data.contains("game_width")) {new_config["game_width"] = json_data["game_width"];}
             if (json_data.contains("game_height")) {new_config["game_height"] = json_data["game_height"];}
             if (json_data.contains("debug")) {new_config["debug"] = json_data["debug"];}
+            if (json_data.contains("software_shapes")) {new_config["software_shapes"] = json_data["software_shapes"];}
         } catch(json::parse_error& err) {
             printf("[!] Error parsing config.json: %s\n", err.what());
         }
@@ -451,6 +590,8 @@ void save_settings() {
     new_config["music_volume"] = music_volume;
     new_config["sfx_volume"] = sfx_volume;
     new_config["mono_toggle"] = mono_toggle;
+    new_config["audio_offset"] = audio_offset;
+    new_config["audio_buffer_size"] = audio_buffer_size;
     new_config["display_fps"] = fps_toggle;
     new_config["fullscreen"] = fullscreen_toggle;
     new_config["vsync"] = vsync_toggle;
@@ -471,6 +612,33 @@ void save_settings() {
     return;
 }
 
+void save_audio_offset() {
+    // writes only audio_offset back to config.json, used by the calibration screen
+    // everything else in the file is left as is, so unsaved changes from the options menu don't get saved along with it
+    nlohmann::ordered_json config;
+    std::ifstream ifs("config.json");
+
+    if (ifs.good()) {
+        try {
+            config = nlohmann::ordered_json::parse(ifs);
+        } catch(json::parse_error& err) {
+            printf("[!] Error parsing config.json, audio offset not saved: %s\n", err.what());
+            return;
+        }
+
+        ifs.close();
+    }
+
+    config["audio_offset"] = audio_offset;
+
+    printf("Saving audio offset to config.json...\n");
+
+    std::ofstream file("config.json");
+    file << config.dump(4);
+
+    return;
+}
+
 void load_settings(int argc, char* argv[]) {
     printf("Loading configuration...\n");
     std::ifstream ifs("config.json");
@@ -501,6 +669,12 @@ void load_settings(int argc, char* argv[]) {
     if (json_data.contains("music_volume"))      {music_volume = json_data["music_volume"];}
     if (json_data.contains("sfx_volume"))        {sfx_volume = json_data["sfx_volume"];}
     if (json_data.contains("mono_toggle"))       {mono_toggle = json_data["mono_toggle"];}
+    if (json_data.contains("audio_offset"))      {audio_offset = json_data["audio_offset"];}
+    if (json_data.contains("audio_buffer_size")) {audio_buffer_size = json_data["audio_buffer_size"];}
+
+    // kept to the same ranges the options menu allows, since a bad buffer size stops the mixer from opening at all
+    audio_offset = fmin(fmax(audio_offset, -500), 500);
+    audio_buffer_size = fmin(fmax(audio_buffer_size, 256), 4096);
     if (json_data.contains("controller_rumble")) {rumble_toggle = json_data["controller_rumble"];}
     if (json_data.contains("controller_index"))  {controller_index = json_data["controller_index"];}
 
@@ -538,11 +712,13 @@ void load_settings(int argc, char* argv[]) {
     if (json_data.contains("game_width")) {width = json_data["game_width"];}
     if (json_data.contains("game_height")) {height = json_data["game_height"];}
     if (json_data.contains("debug")) {debug_toggle = json_data["debug"];}
+    if (json_data.contains("software_shapes")) {software_shapes_toggle = json_data["software_shapes"];}
 
     // parse any command-line arguments relevant to game settings here
     // this is done after loading; i.e. overriding whatever settings we have
     if (parse_option(argv, argv+argc, "-fullscreen") || parse_option(argv, argv+argc, "-f")) {printf("Enabling borderless fullscreen...\n"); fullscreen_toggle = true;}
     if (parse_option(argv, argv+argc, "-vsync") || parse_option(argv, argv+argc, "-v")) {printf("Enabling vertical sync...\n"); vsync_toggle = true;}
+    if (parse_option(argv, argv+argc, "-software-shapes") || parse_option(argv, argv+argc, "-ss")) {printf("Enabling software shape drawing...\n"); software_shapes_toggle = true;}
 
     if (parse_option(argv, argv+argc, "-true-fullscreen") || parse_option(argv, argv+argc, "-tf")) {
         printf("[!] Enabling true fullscreen. Graphical bugs may occur!\n");
@@ -555,17 +731,145 @@ void load_settings(int argc, char* argv[]) {
         debug_toggle = true;
     }
 
+    set_core_debug(debug_toggle);
+    return;
+}
+
+// the level catalog (level_catalog.json) remembers what load_levels() found last time, so unchanged folders and playlists aren't re-read
+// it's keyed by path, and an entry is only trusted if the folder/file's modification time still matches
+// ----------------------------------------------------------
+// folders: {"mtime": ..., "contains_level": true/false}
+// playlists: {"mtime": ..., "name": "...", "levels": ["...", ...]}
+const int level_catalog_version = 1;
+
+json old_level_catalog;
+json new_level_catalog;
+
+long long get_catalog_mtime(const std::filesystem::path &path) {
+    // returns a path's modification time as a plain number, or -1 if it can't be read
+    std::error_code err;
+    auto mtime = std::filesystem::last_write_time(path, err);
+
+    if (err) {return -1;}
+    return mtime.time_since_epoch().count();
+}
+
+const json *get_catalog_entry(const string &type, const string &key, long long mtime) {
+    // returns the cached entry for key, or NULL if there isn't one or it's out of date
+    if (mtime == -1 || !old_level_catalog.contains(type) || !old_level_catalog[type].contains(key)) {return NULL;}
+
+    const json &entry = old_level_catalog[type][key];
+    if (entry.value("mtime", -1LL) != mtime) {return NULL;}
+
+    return &entry;
+}
+
+bool check_level_pack(const string &path) {
+    // returns true if a level path points at a level pack (e.g. "assets/levels/foobar.ompack") rather than a folder
+    return std::filesystem::path(path).extension() == ".ompack";
+}
+
+bool check_level_folder(const std::filesystem::path &folder) {
+    // returns true if a folder contains a level.json (or a compiled level.omlvl), or if it's a level pack
+    // adding or removing a file changes the folder's modification time, so the catalog's answer can be reused if that hasn't changed
+    string key = folder.string();
+    long long mtime = get_catalog_mtime(folder);
+    const json *entry = get_catalog_entry("folders", key, mtime);
+    bool contains_level;
+
+    if (entry != NULL) {
+        contains_level = entry->value("contains_level", false);
+    } else if (check_level_pack(key)) {
+        std::error_code err;
+        contains_level = std::filesystem::is_regular_file(folder, err);
+    } else {
+        std::error_code err;
+        contains_level = std::filesystem::exists(folder / "level.json", err) || std::filesystem::exists(folder / "level.omlvl", err);
+    }
+
+    if (mtime != -1) {new_level_catalog["folders"][key] = {{"mtime", mtime}, {"contains_level", contains_level}};}
+
+    return contains_level;
+}
+
+bool read_playlist(const std::filesystem::path &file, string &name, vector<string> &levels) {
+    // reads a playlist's name and level list, from the catalog if the file hasn't changed since it was cached
+    string key = file.string();
+    long long mtime = get_catalog_mtime(file);
+    const json *entry = get_catalog_entry("playlists", key, mtime);
+
+    if (entry == NULL) {
+        std::ifstream ifs(file);
+        json playlist_data;
+
+        // checks to see if the JSON is valid JSON
+        try {
+            playlist_data = json::parse(ifs);
+        } catch(json::parse_error& err) {
+            printf("[!] Error parsing playlist file: %s\n", err.what());
+            return false;
+        }
+
+        json playlist_levels = json::array();
+
+        if (playlist_data[1]["levels"].is_array()) {
+            for (unsigned int i = 0; i < playlist_data[1]["levels"].size(); i++) {
+                if (playlist_data[1]["levels"][i].is_string()) {playlist_levels.push_back(playlist_data[1]["levels"][i]);}
+            }
+        }
+
+        new_level_catalog["playlists"][key] = {{"mtime", mtime}, {"name", playlist_data[0].value("name", "Untitled Playlist")}, {"levels", playlist_levels}};
+        entry = &new_level_catalog["playlists"][key];
+    } else {
+        new_level_catalog["playlists"][key] = *entry;
+    }
+
+    name = entry->value("name", "Untitled Playlist");
+    levels = entry->value("levels", vector<string>());
+
+    return true;
+}
+
+void load_level_catalog() {
+    old_level_catalog = json::object();
+    new_level_catalog = {{"version", level_catalog_version}, {"folders", json::object()}, {"playlists", json::object()}};
+
+    std::ifstream ifs("level_catalog.json");
+    if (!ifs.good()) {return;}
+
+    try {
+        old_level_catalog = json::parse(ifs);
+    } catch(json::parse_error& err) {
+        printf("[!] Error parsing level_catalog.json, rebuilding it: %s\n", err.what());
+        old_level_catalog = json::object();
+        return;
+    }
+
+    if (!old_level_catalog.is_object() || old_level_catalog.value("version", 0) != level_catalog_version) {old_level_catalog = json::object();}
+
+    return;
+}
+
+void save_level_catalog() {
+    // only writes the catalog if something changed since it was loaded
+    if (new_level_catalog == old_level_catalog) {return;}
+
+    std::ofstream file("level_catalog.json");
+    file << new_level_catalog.dump();
+
     return;
 }
 
 void load_levels() {
-    // usually ran just once during game startup, so speed isn't *that* important here
+    // usually ran just once during game startup
     // scans for level folders, then loads the level_paths vector with any valid levels
+    // anything that hasn't changed since the last scan comes from the level catalog (see above), which keeps this quick for very large level packs
 
     const std::filesystem::path levels{"assets/levels"};
     unsigned int scanned_level_count = 0; // unsigned since a negative level count makes no sense
     vector<std::filesystem::path> playlist_paths;
     vector<std::filesystem::path> folder_paths;
+    std::unordered_set<string> added_levels; // used to skip levels that have already been added, without searching level_paths each time
 
     printf("Scanning for levels...\n");
 
@@ -574,9 +878,15 @@ void load_levels() {
         return;
     }
 
+    load_level_catalog();
+
+    for (int i = 0; i < level_paths.size(); i++) {
+        added_levels.insert(level_paths[i]);
+    }
+
     // scans the levels folder for all files and folders, populating two vectors to be processed separately
     for (auto& dir_entry: std::filesystem::directory_iterator{levels}) {
-        if (std::filesystem::is_directory(dir_entry.path())) {
+        if (dir_entry.is_directory() || dir_entry.path().extension() == ".ompack") {
             folder_paths.push_back(dir_entry.path());
             continue;
         }
@@ -593,69 +903,49 @@ void load_levels() {
 
     printf("Processing playlists...\n");
     for (std::filesystem::path dir_entry: playlist_paths) {
-        std::ifstream ifs(dir_entry);
-        json playlist_data;
         string playlist_name;
+        vector<string> playlist_levels;
 
-        // checks to see if the JSON is valid JSON
-        try {
-            playlist_data = json::parse(ifs);
-        } catch(json::parse_error& err) {
-            printf("[!] Error parsing playlist file: %s\n", err.what());
-            continue;
-        }
+        if (!read_playlist(dir_entry, playlist_name, playlist_levels)) {continue;}
 
-        playlist_name = playlist_data[0].value("name", "Untitled Playlist");
         printf("Parsing playlist: %s\n", playlist_name.c_str());
 
-        for (unsigned int i = 0; i < playlist_data[1]["levels"].size(); i++) {
-            std::filesystem::path playlist_level = levels / playlist_data[1]["levels"][i];
+        for (unsigned int i = 0; i < playlist_levels.size(); i++) {
+            std::filesystem::path playlist_level = levels / playlist_levels[i];
 
-            if (std::filesystem::exists(playlist_level.string())) {
-                // checks if the level isn't present already
-                if (std::find(level_paths.begin(), level_paths.end(), playlist_level.string()) != level_paths.end()) {continue;}
+            // checks if the level isn't present already, and that the folder contains a level
+            if (added_levels.count(playlist_level.string()) > 0) {continue;}
+            if (!check_level_folder(playlist_level)) {continue;}
 
-                // checks if the folder contains a level.json
-                bool contains_level = false;
+            // okay it isn't, cool, add it to the list
+            level_paths.push_back(playlist_level.string());
+            level_playlists.push_back(playlist_name);
+            added_levels.insert(playlist_level.string());
+            scanned_level_count++;
 
-                for (auto& file_entry: std::filesystem::directory_iterator{playlist_level}) {
-                    string filename = file_entry.path().filename().string();
-                    if (filename == "level.json") {contains_level = true; break;}
-                }
-
-                if (!contains_level) {continue;}
-
-                // okay it isn't, cool, add it to the list
-                level_paths.push_back(playlist_level.string());
-                level_playlists.push_back(playlist_name);
-                scanned_level_count++;
-
-                printf("Added level from playlist: %s\n", playlist_level.string().c_str());
-            }
+            printf("Added level from playlist: %s\n", playlist_level.string().c_str());
         }
     }
 
     printf("Processing level folders...\n");
     for (std::filesystem::path dir_entry: folder_paths) {
         // checks if the level isn't present from a playlist already, prevents duplicated levels
-        if (std::find(level_paths.begin(), level_paths.end(), dir_entry.string()) != level_paths.end()) {continue;}
+        if (added_levels.count(dir_entry.string()) > 0) {continue;}
 
-        // checks for the existence of a level.json file within the current directory
-        for (auto& subdir_entry: std::filesystem::directory_iterator{dir_entry}) {
-            string filename = subdir_entry.path().filename().string();
+        // checks for the existence of a level.json (or a compiled level.omlvl) file within the current directory
+        if (!check_level_folder(dir_entry)) {continue;}
 
-            if (filename == "level.json") {
-                string level_path = dir_entry.string();
-                level_paths.push_back(level_path);
-                level_playlists.push_back("");
-                scanned_level_count++;
+        string level_path = dir_entry.string();
+        level_paths.push_back(level_path);
+        level_playlists.push_back("");
+        added_levels.insert(level_path);
+        scanned_level_count++;
 
-                printf("Added level: %s\n", level_path.c_str());
-                break;
-            }
-        }
+        printf("Added level: %s\n", level_path.c_str());
     }
 
+    save_level_catalog();
+
     if (scanned_level_count == 0) {
         printf("[!] No levels were found!\n");
     } else if (scanned_level_count == 1) {
@@ -835,6 +1125,7 @@ void rumble_controller(int ms = 120) {
 void set_music_volume() {
     // wrapper that scales volume (0-100) to mix_volume's range (0-128)
     Mix_VolumeMusic(music_volume * 1.28);
+    stage_song_volume = music_volume * 1.28;
     return;
 }
 
@@ -892,6 +1183,10 @@ void set_vsync_renderer() {
     // sets VSYNC flag in SDL2 and re-creates the renderer
     SDL_SetHint(SDL_HINT_RENDER_VSYNC, to_string(vsync_toggle).c_str());
 
+    // the shape layer and atlas are thrown out first, while their textures still exist; they're rebuilt the next time they're drawn
+    reset_shape_layer();
+    reset_shape_atlas();
+
     SDL_DestroyRenderer(renderer);
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
 
@@ -1027,6 +1322,8 @@ bool init(int argc, char *argv[]) {
         return false;
     }
 
+    init_timer();
+
     // create window
     printf("Creating window with resolution %i x %i...\n", width, height);
     window = SDL_CreateWindow("Open Manifold", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_RESIZABLE);
@@ -1060,11 +1357,13 @@ bool init(int argc, char *argv[]) {
 
     // starts up audio and sets volumes
     printf("Creating audio mixer...\n");
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, audio_buffer_size) < 0) {
         printf("[!] Error creating audio mixer: %s\n", Mix_GetError());
         return false;
     }
 
+    init_song_clock();
+
     set_music_volume();
     set_sfx_volume();
     set_channel_mix();
@@ -1095,44 +1394,18 @@ void kill() {
     SDL_Quit();
 }
 
+// these return values from the latest snapshot, since they're read while rendering
+// gameplay code uses game directly instead
 int get_life() {
-    return life;
+    return render_snapshot.life;
 }
 
 int get_score() {
-    return score;
+    return render_snapshot.score;
 }
 
 int get_combo() {
-    return combo;
-}
-
-void modify_life(int mod) {
-    // adds or subtracts life value; wrapped up to ensure it's capped consistently
-    life += mod;
-
-    if (life < 0) {life = 0;}
-    if (life > 100) {life = 100;}
-    return;
-}
-
-void reset_score() {
-    score = 0;
-    combo = 0;
-    set_combo_timer(0);
-    return;
-}
-
-void reset_life() {
-    life = 100;
-    return;
-}
-
-void reset_score_and_life() {
-    // wrapper for two other functions
-    reset_score();
-    reset_life();
-    return;
+    return render_snapshot.combo;
 }
 
 string get_motd() {
@@ -1154,10 +1427,43 @@ string get_character_tile_path() {
     return path;
 }
 
-string get_level_name() {
-    if (json_file == NULL) {return "Untitled";}
+SDL_RWops* open_level_asset(string name) {
+    // opens one of the current level's files (e.g. "song.ogg") for reading
+    // files in a level pack are read straight out of the mapped pack without being copied, so it has to stay open while they're in use
+    // returns NULL (with SDL_GetError() set) if the file doesn't exist
+    if (check_level_pack(level_paths[level_index])) {
+        const unsigned char *data;
+        size_t size;
+
+        if (!find_pack_entry(current_pack, name, data, size)) {
+            SDL_SetError("Couldn't find %s in level pack", name.c_str());
+            return NULL;
+        }
+
+        return SDL_RWFromConstMem(data, size);
+    }
+
+    string path = level_paths[level_index] + "/" + name;
+    return SDL_RWFromFile(path.c_str(), "rb");
+}
+
+bool read_level_asset(string name, string &contents) {
+    // reads one of the current level's files into contents; returns false if it doesn't exist
+    SDL_RWops *file = open_level_asset(name);
+    size_t size;
+
+    if (file == NULL) {return false;}
+
+    void *data = SDL_LoadFile_RW(file, &size, 1);
+    if (data == NULL) {return false;}
 
-    return json_file[0].value("name", "Untitled");
+    contents.assign((const char*) data, size);
+    SDL_free(data);
+    return true;
+}
+
+const string& get_level_name() {
+    return level_data.name;
 }
 
 string get_level_playlist_name() {
@@ -1167,22 +1473,16 @@ string get_level_playlist_name() {
     return name;
 }
 
-string get_genre() {
-    if (json_file == NULL) {return "Unknown";}
-
-    return json_file[0].value("genre", "Unknown");
+const string& get_genre() {
+    return level_data.genre;
 }
 
-string get_level_author() {
-    if (json_file == NULL) {return "Anonymous";}
-
-    return json_file[0].value("level_author", "Anonymous");
+const string& get_level_author() {
+    return level_data.level_author;
 }
 
-string get_song_author() {
-    if (json_file == NULL) {return "Anonymous";}
-
-    return json_file[0].value("song_author", "Anonymous");
+const string& get_song_author() {
+    return level_data.song_author;
 }
 
 int get_hiscore() {
@@ -1198,69 +1498,35 @@ bool get_cleared() {
 }
 
 string get_cpu_sequence() {
-    return cpu_sequence;
+    return render_snapshot.cpu_sequence;
 }
 
 string get_player_sequence() {
-    return player_sequence;
+    return render_snapshot.player_sequence;
 }
 
 int get_level_bpm() {
-    if (json_file == NULL) {return 120;}
-
-    return json_file[0].value("bpm", 120);
+    return level_data.bpm;
 }
 
 int get_level_time_signature(bool top_or_bottom) {
     if (top_or_bottom) {
-        return json_file[0].value("time_signature_top", 4);
+        return level_data.time_signature_top;
     } else {
-        return json_file[0].value("time_signature_bottom", 4);
+        return level_data.time_signature_bottom;
     }
 }
 
 int get_level_measure_length() {
-    int top = get_level_time_signature(true);
-    int bot = get_level_time_signature(false);
-    return top * bot;
-}
-
-int get_level_intro_delay() {
-    int sequence_length = get_level_measure_length() * 2;
-
-    return json_file[0].value("offset", sequence_length);
+    return level_data.measure_length;
 }
 
 int get_bg_color() {
-    int value = 15;
-
-    // "bgColor" is a legacy/deprecated property, and should not be used anymore
-    if (json_file[0].contains("bgColor")) {
-        value = json_file[0].value("bgColor", 15);
-    }
-
-    // we give bg_color (the newer one) higher priority
-    if (json_file[0].contains("bg_color")) {
-        value = json_file[0].value("bg_color", 15);
-    }
-
-    return value;
-}
-
-int get_song_step(int index, int placeholder) {
-    // gets value of song_step for a given shape index in a file
-
-    if (index > json_file.size()) {return placeholder;}
-
-    if (json_file[index].contains("song_step")) {
-        return json_file[index].value("song_step", placeholder);
-    }
-
-    return placeholder;
+    return level_data.bg_color;
 }
 
-string get_level_background_effect_string() {
-    return json_file[0].value("background_effect", "none");
+const string& get_level_background_effect_string() {
+    return level_data.background_effect;
 }
 
 bool get_debug() {
@@ -1308,58 +1574,46 @@ string get_input_name() {
     return get_lang_string("button." + to_string(index));
 }
 
-int calculate_score() {
-    // calculates a score to give the player by comparing sequence strings
-    // ----------------------------------------------------------
-    // SCORE TABLE IS: 100 for any ops that match CPU (except blanks), 50 for new ops, 25 for new xplodes
-    int score = 0;
-    string cpu_sequence = get_cpu_sequence();
-    string player_sequence = get_player_sequence();
-
-    if (get_debug()) {
-        printf("CPU: %s\nPLY: %s\n", cpu_sequence.c_str(), player_sequence.c_str());
-    }
+json& get_hiscore_data() {
+    // returns the contents of hiscores.json; it's only read from disk the first time, and kept up to date by the save_ functions below
+    if (hiscores_loaded) {return hiscore_data;}
 
-    for (int i = 0; i < player_sequence.length(); i++) {
-        char cpu_op = cpu_sequence[i];
-        char player_op = player_sequence[i];
+    hiscores_loaded = true;
+    hiscore_data = json::object();
+    std::ifstream ifs("hiscores.json");
 
-        if (cpu_op == '.') {
-            if (player_op == '.') {continue;}
-            if (player_op == 'X') {score += 25; continue;}
-            score += 50;
+    if (ifs.good()) {
+        try {
+            hiscore_data = json::parse(ifs);
+        } catch(json::parse_error& err) {
+            printf("[!] Error parsing hiscores.json: %s\n", err.what());
         }
 
-        // if we're at this point in the loop, then we know that:
-        // score is 50, cpu_op isn't blank, player_op also isn't blank or an xplode
-
-        if (cpu_op == player_op) {score += 50; continue;}
+        ifs.close();
     }
 
-    return score;
+    if (!hiscore_data.is_object()) {hiscore_data = json::object();}
+
+    return hiscore_data;
+}
+
+void write_hiscore_data() {
+    std::ofstream file("hiscores.json");
+    file << get_hiscore_data().dump(4);
+    return;
 }
 
 void load_metadata() {
     int score = 0;
     int play_count = 0;
     bool cleared = false;
-    string current_level = get_level_name();
-    std::ifstream ifs("hiscores.json");
-
-    if (ifs.good()) {
-        try {
-            json json_data = json::parse(ifs);
-
-            if (json_data.contains(current_level)) {
-                score = json_data[current_level].value("score", 0);
-                play_count = json_data[current_level].value("play_count", 0);
-                cleared = json_data[current_level].value("cleared", false);
-            }
-        } catch(json::parse_error& err) {
-            printf("[!] Error parsing hiscores.json: %s\n", err.what());
-        }
+    const string &current_level = get_level_name();
+    json &json_data = get_hiscore_data();
 
-        ifs.close();
+    if (json_data.contains(current_level)) {
+        score = json_data[current_level].value("score", 0);
+        play_count = json_data[current_level].value("play_count", 0);
+        cleared = json_data[current_level].value("cleared", false);
     }
 
     metadata.hiscore = score;
@@ -1372,20 +1626,8 @@ void save_score() {
     // saves the current score value to the currently selected level's entry in hiscores.json
     int current_hiscore = 0;
     int new_score = get_score();
-    string current_level = get_level_name();
-
-    json json_data;
-    std::ifstream ifs("hiscores.json");
-
-    if (ifs.good()) {
-        try {
-            json_data = json::parse(ifs);
-        } catch(json::parse_error& err) {
-            printf("[!] Error parsing hiscores.json: %s\n", err.what());
-        }
-
-        ifs.close();
-    }
+    const string &current_level = get_level_name();
+    json &json_data = get_hiscore_data();
 
     // check if level has a saved hiscore already
     if (json_data.contains(current_level)) {
@@ -1396,8 +1638,7 @@ void save_score() {
     if (new_score > current_hiscore) {
         printf("Saving new hi-score for %s...\n", current_level.c_str());
         json_data[current_level]["score"] = new_score;
-        std::ofstream file("hiscores.json");
-        file << json_data.dump(4);
+        write_hiscore_data();
     }
 
     return;
@@ -1407,25 +1648,12 @@ void save_play_count() {
     // saves the current play count to the currently selected level's entry in hiscores.json
     // or more accurately it just increments it by 1
     unsigned int play_count = metadata.play_count;
-    string current_level = get_level_name();
-
-    json json_data;
-    std::ifstream ifs("hiscores.json");
-
-    if (ifs.good()) {
-        try {
-            json_data = json::parse(ifs);
-        } catch(json::parse_error& err) {
-            printf("[!] Error parsing hiscores.json: %s\n", err.what());
-        }
-
-        ifs.close();
-    }
+    const string &current_level = get_level_name();
+    json &json_data = get_hiscore_data();
 
     printf("Saving play count for %s...\n", current_level.c_str());
     json_data[current_level]["play_count"] = play_count + 1;
-    std::ofstream file("hiscores.json");
-    file << json_data.dump(4);
+    write_hiscore_data();
 
     return;
 }
@@ -1433,20 +1661,8 @@ void save_play_count() {
 void save_cleared() {
     // saves a cleared flag to the currently selected level's entry in hiscores.json
     bool cleared = false;
-    string current_level = get_level_name();
-
-    json json_data;
-    std::ifstream ifs("hiscores.json");
-
-    if (ifs.good()) {
-        try {
-            json_data = json::parse(ifs);
-        } catch(json::parse_error& err) {
-            printf("[!] Error parsing hiscores.json: %s\n", err.what());
-        }
-
-        ifs.close();
-    }
+    const string &current_level = get_level_name();
+    json &json_data = get_hiscore_data();
 
     // check if level has been cleared already
     if (json_data.contains(current_level)) {
@@ -1457,8 +1673,7 @@ void save_cleared() {
     if (metadata.cleared && !cleared) {
         printf("Saving level clear flag for %s...\n", current_level.c_str());
         json_data[current_level]["cleared"] = true;
-        std::ofstream file("hiscores.json");
-        file << json_data.dump(4);
+        write_hiscore_data();
     }
 }
 
@@ -1470,22 +1685,22 @@ void save_metadata() {
     return;
 }
 
-bool check_json_validity() {
-    // returns false if the level json object is NULL
+bool check_level_loaded() {
+    // returns false if the current level couldn't be loaded
     // used in the level select in graphics.cpp
 
-    return json_file != NULL;
+    return level_loaded;
 }
 
 void load_tile_frame_file() {
     string file = level_paths[level_index] + "/tile.json";
-    std::ifstream ifs(file);
+    string contents;
     json parsed_json;
 
     printf("Loading tile frames file: %s\n", file.c_str());
 
     // checks to make sure the file exists
-    if (std::filesystem::exists(file) == false) {
+    if (read_level_asset("tile.json", contents) == false) {
         printf("Tile frames file does not exist, skipping...\n");
         fallback_tile_frames();
         return;
@@ -1493,7 +1708,7 @@ void load_tile_frame_file() {
 
     // checks to see if the JSON is valid JSON
     try {
-        parsed_json = json::parse(ifs);
+        parsed_json = json::parse(contents);
     } catch(json::parse_error& err) {
         printf("[!] Error parsing tile frames file: %s\n", err.what());
         fallback_tile_frames();
@@ -1506,20 +1721,20 @@ void load_tile_frame_file() {
 
 void load_character_file() {
     string file = level_paths[level_index] + "/character.json";
-    std::ifstream ifs(file);
+    string contents;
     json parsed_json;
 
     printf("Loading character file: %s\n", file.c_str());
 
     // checks to make sure the file exists
-    if (std::filesystem::exists(file) == false) {
+    if (read_level_asset("character.json", contents) == false) {
         printf("Character file does not exist, skipping...\n");
         return;
     }
 
     // checks to see if the JSON is valid JSON
     try {
-        parsed_json = json::parse(ifs);
+        parsed_json = json::parse(contents);
     } catch(json::parse_error& err) {
         printf("[!] Error parsing character file: %s\n", err.what());
         return;
@@ -1530,39 +1745,151 @@ void load_character_file() {
     return;
 }
 
-void load_default_music(string name) {
-    Mix_HaltMusic();
-    Mix_FreeMusic(music);
+void stage_music_hook(void *udata, Uint8 *stream, int len) {
+    // music hook that plays the in-memory stage song; runs on the audio thread
+    // the stream has already been silenced by SDL_mixer, so the song is just mixed on top of it
+    if (!stage_song_playing) {return;}
 
-    string filename = "assets/music/" + name + ".ogg";
-    printf("Loading music: %s\n", filename.c_str());
-    music = Mix_LoadMUS(filename.c_str());
+    Uint32 position = stage_song_position.load();
+    if (position >= stage_song->alen) {
+        stage_song_playing = false;
+        return;
+    }
 
-    if(music == NULL) {
-        printf("%s\n", Mix_GetError());
-    } else {
-        Mix_PlayMusic(music, -1);
+    int amount = fmin(len, stage_song->alen - position);
+    int volume = stage_song_volume;
+
+    // fades out one buffer at a time; the buffers are short enough that this doesn't step audibly
+    int fade_length = stage_song_fade_length;
+    if (fade_length > 0) {
+        int fade_left = stage_song_fade_left;
+
+        if (fade_left <= 0) {
+            stage_song_playing = false;
+            return;
+        }
+
+        volume = volume * ((float)fade_left / fade_length);
+        stage_song_fade_left = fmax(0, fade_left - amount);
     }
+
+    SDL_MixAudioFormat(stream, stage_song->abuf + position, stage_song_format, amount, volume);
+
+    // if the song was seeked while this buffer was being mixed, the seek wins
+    stage_song_position.compare_exchange_strong(position, position + amount);
     return;
 }
 
-void load_stage_music() {
-    Mix_HaltMusic();
-    Mix_FreeMusic(music);
-
-    string filename = level_paths[level_index] + "/song.ogg";
-    printf("Loading music: %s\n", filename.c_str());
-    music = Mix_LoadMUS(filename.c_str());
+void unload_stage_music() {
+    // unhooks and frees the in-memory stage song, if there is one
+    // Mix_HookMusic() locks the audio device, so the hook is guaranteed to not be running afterwards
+    stage_song_playing = false;
+    Mix_HookMusic(NULL, NULL);
 
-    if(music == NULL) {
-        printf("%s\n", Mix_GetError());
+    if (stage_song != NULL) {
+        Mix_FreeChunk(stage_song);
+        stage_song = NULL;
     }
+
     return;
 }
 
-Mix_Chunk* load_default_sound(string file_name) {
-    // loads default sounds, in case custom sounds dont exist or otherwise fail to load
-    // also used for the sandbox mode
+void play_stage_music() {
+    // starts the stage song from the beginning
+    if (stage_song == NULL) {
+        Mix_PlayMusic(music, 0);
+        return;
+    }
+
+    stage_song_position = 0;
+    stage_song_fade_length = 0;
+    stage_song_fade_left = 0;
+    stage_song_playing = true;
+    Mix_HookMusic(stage_music_hook, NULL);
+    return;
+}
+
+void seek_stage_music(double seconds) {
+    // jumps to a position (in seconds) in the stage song; safe to call from the simulation thread
+    if (stage_song == NULL) {
+        Mix_SetMusicPosition(seconds);
+        return;
+    }
+
+    Uint32 position = (Uint32)(seconds * stage_song_frequency) * stage_song_frame_size;
+    if (position > stage_song->alen) {position = stage_song->alen;}
+
+    stage_song_position = position;
+    return;
+}
+
+void fade_out_stage_music(int ms) {
+    // fades out the stage song over ms milliseconds, then stops it
+    if (stage_song == NULL) {
+        Mix_FadeOutMusic(ms);
+        return;
+    }
+
+    int fade_length = ((Sint64)ms * stage_song_frequency / 1000) * stage_song_frame_size;
+    stage_song_fade_left = fade_length;
+    stage_song_fade_length = fade_length;
+    return;
+}
+
+void load_default_music(string name) {
+    unload_stage_music();
+    Mix_HaltMusic();
+    Mix_FreeMusic(music);
+
+    string filename = "assets/music/" + name + ".ogg";
+    printf("Loading music: %s\n", filename.c_str());
+    music = Mix_LoadMUS(filename.c_str());
+
+    if(music == NULL) {
+        printf("%s\n", Mix_GetError());
+    } else {
+        Mix_PlayMusic(music, -1);
+    }
+    return;
+}
+
+void load_stage_music() {
+    // decodes the stage song into memory so it can be played by stage_music_hook()
+    // if that doesn't work, falls back to streaming it
+    Uint16 format;
+    int channels;
+
+    unload_stage_music();
+    Mix_HaltMusic();
+    Mix_FreeMusic(music);
+    music = NULL;
+
+    string filename = level_paths[level_index] + "/song.ogg";
+    printf("Loading music: %s\n", filename.c_str());
+
+    if (Mix_QuerySpec(&stage_song_frequency, &format, &channels) != 0) {
+        stage_song_format = format;
+        stage_song_frame_size = channels * (SDL_AUDIO_BITSIZE(format) / 8);
+        stage_song = Mix_LoadWAV_RW(open_level_asset("song.ogg"), 1);
+    }
+
+    if (stage_song != NULL) {
+        if (get_debug()) {printf("Decoded song into memory (%i bytes).\n", stage_song->alen);}
+        return;
+    }
+
+    printf("[!] Couldn't decode song into memory, streaming it instead: %s\n", Mix_GetError());
+    music = Mix_LoadMUS_RW(open_level_asset("song.ogg"), 1);
+
+    if(music == NULL) {
+        printf("%s\n", Mix_GetError());
+    }
+    return;
+}
+
+Mix_Chunk* load_default_sound(string file_name) {
+    // loads default sounds, in case custom sounds dont exist or otherwise fail to load
+    // also used for the sandbox mode
 
     string path = "assets/sound/" + file_name + ".ogg";
     const char* path_cstr = path.c_str();
@@ -1585,7 +1912,7 @@ Mix_Chunk* load_stage_sound(string file_name) {
     const char* path_cstr = path.c_str();
     Mix_Chunk* sound;
 
-    sound = Mix_LoadWAV(path_cstr);
+    sound = Mix_LoadWAV_RW(open_level_asset(file_name + ".ogg"), 1);
 
     // load fallback if sound doesn't/can't exist
     if(sound == NULL) {
@@ -1597,6 +1924,31 @@ Mix_Chunk* load_stage_sound(string file_name) {
     return sound;
 }
 
+Mix_Chunk** get_stage_sound(const string &name) {
+    // returns the variable a level's sound effect is loaded into (e.g. "up" for snd_up), or NULL if name isn't one
+    // used for reloading a single sound (see update_hot_reload())
+    struct {const char *name; Mix_Chunk **sound;} sounds[] = {
+        {"up", &snd_up},
+        {"down", &snd_down},
+        {"left", &snd_left},
+        {"right", &snd_right},
+        {"circle", &snd_circle},
+        {"square", &snd_square},
+        {"triangle", &snd_triangle},
+        {"xplode", &snd_xplode},
+        {"scale_up", &snd_scale_up},
+        {"scale_down", &snd_scale_down},
+        {"success", &snd_success},
+        {"combo", &snd_combo}
+    };
+
+    for (auto &sound: sounds) {
+        if (name == sound.name) {return sound.sound;}
+    }
+
+    return NULL;
+}
+
 void unload_sounds() {
     // frees every sound file used in levels
 
@@ -1682,13 +2034,7 @@ void fade_reset() {
 }
 
 void reset_shapes() {
-    // resets shapes to default values
-    result_shape.type = 0;
-    result_shape.x = 7;
-    result_shape.y = 7;
-    result_shape.scale = 1;
-    result_shape.color = 0;
-
+    // resets the sandbox's shape to default values
     active_shape.type = -1; // this makes the shape render invisible by default
     active_shape.x = 7;
     active_shape.y = 7;
@@ -1698,578 +2044,1085 @@ void reset_shapes() {
     return;
 }
 
-void reset_sequences() {
-    // resets sequences to blank strings
-    int measure_length = get_level_measure_length();
+int check_beat_timing_window(double current_time) {
+    // returns 0 if we're not within the beat, 1 on the "left side" (beat end), 2 on the right side (beat start)
+    // used for the debug background; see the core's version for the details
+    // current_time: on the song clock; the audio offset is taken off here, the same as it is for presses
+    return check_beat_timing_window(game, schedule, current_time - audio_offset);
+}
 
-    cpu_sequence.clear();
-    player_sequence.clear();
-    cpu_sequence.insert(cpu_sequence.begin(), measure_length, '.');
-    player_sequence.insert(player_sequence.begin(), measure_length, '.');
+void play_op_sound(char opcode) {
+    // plays the sound that goes with an op (see apply_shape_op())
+    switch (opcode) {
+        case 'Z': Mix_PlayChannel(-1, snd_circle, 0); break;
+        case 'X': Mix_PlayChannel(-1, snd_square, 0); break;
+        case 'C': Mix_PlayChannel(-1, snd_triangle, 0); break;
+        case 'V': Mix_PlayChannel(-1, snd_xplode, 0); break;
+        case 'A': Mix_PlayChannel(-1, snd_scale_down, 0); break;
+        case 'S': Mix_PlayChannel(-1, snd_scale_up, 0); break;
+        case 'U': Mix_PlayChannel(-1, snd_up, 0); break;
+        case 'D': Mix_PlayChannel(-1, snd_down, 0); break;
+        case 'L': Mix_PlayChannel(-1, snd_left, 0); break;
+        case 'R': Mix_PlayChannel(-1, snd_right, 0); break;
+        default: break;
+    }
 
     return;
 }
 
-int check_beat_timing_window(unsigned int current_time) {
-    // returns 0 if we're not within the beat, 1 on the "left side" (beat end), 2 on the right side (beat start)
-    // the window should be within ~120 ms, or 60ms on each "side" of a beat (roughly equivalent to a "Good" in DDR)
+shape modify_current_shape(char opcode, shape current_shape) {
+    // modifies the shape passed into it using an "opcode" and plays its sound; used by the sandbox
+    // ops do nothing to an invisible shape unless they create one, so those don't get a sound either
+    shape modified_shape = apply_shape_op(opcode, current_shape);
 
-    int current_beat_length = (current_time - beat_start_time);
-    int time_to_next_beat = length - current_beat_length;
-    int measure_length = get_level_measure_length();
-    int start_offset = get_level_intro_delay();
-    bool valid_beat_window_start = false;
-    bool valid_beat_window_end = false;
+    if (modified_shape.type != -1) {play_op_sound(opcode);}
 
-    // this statement excludes all of the intro
-    if (song_start_time + intro_beat_length >= current_time) {return 0;}
+    return modified_shape;
+}
 
-    // and this excludes the end of the song
-    if (song_over) {return 0;}
+void morph_shapes() {
+    for (int i = 0; i < previous_shapes.size(); i++) {
+        int new_type = (previous_shapes[i].type + 1) % 3;
+        previous_shapes[i].type = new_type;
+    }
+    return;
+}
 
-    // this excludes beats where the CPU is in control, as well as parts of beats that shouldnt be 'allowed'
-    // this means that there's not measure_length of valid beats, but rather measure_length of windows
-    if ((beat_count - start_offset)%(measure_length*2) >= measure_length) {valid_beat_window_start = true;}
-    if (((beat_count - start_offset) - 1)%(measure_length*2) >= measure_length) {valid_beat_window_end = true;}
+void morph_colors() {
+    for (int i = 0; i < previous_shapes.size(); i++) {
+        // skip any shapes with the erase color
+        if (previous_shapes[i].color == 16) {continue;}
 
-    // finally, checks the timing window
-    if (valid_beat_window_end && current_beat_length <= 60) {return 1;}
-    if (valid_beat_window_start && time_to_next_beat <= 60) {return 2;}
+        int new_color = (previous_shapes[i].color + 1) % 16;
+        previous_shapes[i].color = new_color;
+    }
+    return;
+}
 
-    return 0;
+void fill_parsed_level(parsed_level &parsed) {
+    // fills in everything else in parsed from a freshly-read parsed.source, generating and checking sequences along the way
+    level_source &source = parsed.source;
+
+    // the level's metadata, done to make get_level_bpm etc. function
+    parsed.info = source.info;
+
+    // checks to see if a color_table exists, and if it does, try to load it
+    for (int i = 0; i < 16; i++) {
+        parsed.palette[i] = get_default_color(i);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        if (!source.color_table_set[i]) {continue;}
+
+        // colors that weren't strings come through as empty ones, and are skipped after being reported
+        if (!check_hex_string(source.color_table[i])) {
+            parsed.issues.push_back({{"type", "malformed_color"}, {"index", i}, {"value", source.color_table[i]}});
+            if (source.color_table[i].empty()) {continue;}
+        }
+
+        parsed.palette[i] = hex_string_to_color(source.color_table[i]);
+    }
+
+    // this entire block generates sequences if they aren't present
+    // note that we generate these even if they're already present in order to ensure a level is actually beatable
+    // it also uses this opportunity to populate previous_shapes for the level select menu
+
+    int max_sequence_length = parsed.info.measure_length;
+    parsed.preview_shapes.clear();
+
+    for (int i = 1; i <= source.shapes.size(); i++) {
+        level_shape_entry &entry = source.shapes[i - 1];
+        int shape_type = entry.target.type;
+        int x = entry.target.x;
+        int y = entry.target.y;
+        int scale = entry.target.scale;
+
+        bool sequence_exists = entry.has_sequence;
+        string gen_sequence;
+
+        // populates the previous_shapes struct
+        // used for displaying the full face in the level select
+        parsed.preview_shapes.push_back(entry.target);
+        parsed.preview_shapes.insert(parsed.preview_shapes.end(), entry.auto_shapes.begin(), entry.auto_shapes.end());
+
+        // the shortest sequence that makes the shape (see the shape solver in core.cpp)
+        int shape_distance = get_shape_distance(entry.target);
+        gen_sequence = solve_shape_sequence(entry.target);
+
+        if (shape_distance == -1) {
+            printf("[!] Shape #%i can't be made by any sequence! Level is not winnable.\n", i);
+            parsed.issues.push_back({{"type", "impossible_shape"}, {"shape", i}});
+        }
+
+        // checks to see if the shape can be made within the allotted number of beats
+        if (shape_distance > max_sequence_length) {
+            printf("[!] Shape #%i needs at least %i beats, more than the max number of beats! Level is not winnable.\n", i, shape_distance);
+            parsed.issues.push_back({{"type", "unwinnable"}, {"shape", i}, {"length", shape_distance}, {"expected", max_sequence_length}});
+        }
+
+        // pads the sequence with NOPs
+        if (gen_sequence.length() < max_sequence_length) {
+            gen_sequence.insert(gen_sequence.end(), max_sequence_length - gen_sequence.length(), '.');
+        }
+
+        if (get_debug()) {printf("gen_seq: %s\n", gen_sequence.c_str());}
+
+        // check if a sequence is defined for this shape, if not, use the generated one
+        // checking this AFTER making a sequence is inefficient, but also makes it much
+        // more likely to catch impossible levels and is negligible on performance
+        if (sequence_exists) {
+            string cur_sequence = entry.sequence;
+            if (get_debug()) {printf("cur_seq: %s\n", cur_sequence.c_str());}
+            int cur_seq_length = cur_sequence.length(); // fixes GCC warning
+
+            // similar to the above checks for generated sequences
+            if (cur_seq_length > max_sequence_length) {
+                printf("Level sequence #%i is too long (must be %i, is %i)! Truncating...\n", i, max_sequence_length, cur_seq_length);
+                parsed.issues.push_back({{"type", "truncated_sequence"}, {"shape", i}, {"length", cur_seq_length}, {"expected", max_sequence_length}});
+                entry.sequence = cur_sequence.substr(0, max_sequence_length);
+            }
+
+            if (cur_seq_length < max_sequence_length) {
+                printf("Level sequence #%i is too short (must be %i, is %i)! Padding...\n", i, max_sequence_length, cur_seq_length);
+                parsed.issues.push_back({{"type", "padded_sequence"}, {"shape", i}, {"length", cur_seq_length}, {"expected", max_sequence_length}});
+                cur_sequence.insert(cur_sequence.end(), max_sequence_length - cur_seq_length, '.');
+                entry.sequence = cur_sequence;
+            }
+
+            // we create a new shape here since s has been used for auto_shapes earlier
+            if (!check_sequence_validity(cur_sequence, {shape_type, x, y, scale, 0})) {
+                printf("[!] Sequence #%i does not match expected shape, using fallback...\n", i);
+                parsed.issues.push_back({{"type", "invalid_sequence"}, {"shape", i}});
+                entry.sequence = gen_sequence;
+            }
+
+            continue;
+        } else {
+            entry.sequence = gen_sequence;
+            entry.has_sequence = true;
+        }
+    }
+
+    compile_level_schedule(source, parsed.schedule);
+    parsed.loaded = true;
+
+    return;
 }
 
-bool compare_shapes(shape shape_1, shape shape_2) {
-    // returns true if the player and CPU shapes match properties
+bool parse_level_json(string file, parsed_level &parsed) {
+    // loads a JSON file and parses it into parsed, filling in blanks if needed
+    // the file's read in a single pass straight into parsed.source (see parse_level_stream() in level.cpp), without building a JSON document first
+    // ----------------------------------------------------------
+    // file: a path to a file, usually supplied by get_level_json_path() ("assets/levels/foobar/level.json")
+
+    if (get_debug()) {printf("Parsing level file: %s\n", file.c_str());}
+
+    std::ifstream ifs(file);
+    level_source &source = parsed.source;
+    string error;
+
+    // checks to make sure the file exists
+    if (std::filesystem::exists(file) == false) {
+        printf("[!] Couldn't parse level file: Does not exist.\n");
+        parsed.issues.push_back({{"type", "missing_file"}});
+        return false;
+    }
 
-    if (shape_1.x != shape_2.x) return false;
-    if (shape_1.y != shape_2.y) return false;
-    if (shape_1.type != shape_2.type) return false;
-    if (shape_1.scale != shape_2.scale) return false;
+    // checks to see if the JSON is valid JSON
+    if (!parse_level_stream(ifs, source, error)) {
+        printf("[!] Error parsing level file: %s\n", error.c_str());
+        parsed.issues.push_back({{"type", "parse_error"}, {"message", error}});
+        return false;
+    }
 
+    fill_parsed_level(parsed);
     return true;
 }
 
-shape modify_current_shape(char opcode, shape current_shape, bool is_player = false, bool play_sound = true) {
-    // modifies the shape passed into it using an "opcode"
+bool read_compiled_level(const mapped_level &level, parsed_level &parsed) {
+    // reads a compiled level that's already in memory into parsed
+    unsigned char palette[16][4];
+
+    if (!read_level_file(level, parsed.info, parsed.preview_shapes, palette, parsed.schedule)) {return false;}
+
+    for (int i = 0; i < 16; i++) {
+        parsed.palette[i] = {palette[i][0], palette[i][1], palette[i][2], palette[i][3]};
+    }
+
+    parsed.loaded = true;
+    return true;
+}
+
+bool parse_compiled_level_file(string file, parsed_level &parsed) {
+    // loads a compiled level into parsed; the level is mapped into memory just long enough to copy everything out of it
+    // the metadata, shapes and schedule are all read straight from the file
+
+    if (get_debug()) {printf("Loading compiled level file: %s\n", file.c_str());}
+
+    mapped_level level;
+
+    if (!map_level_file(file, level)) {
+        printf("[!] Couldn't map compiled level file: %s\n", file.c_str());
+        return false;
+    }
+
+    bool success = read_compiled_level(level, parsed);
+    unmap_level_file(level);
+
+    return success;
+}
+
+bool parse_level_pack(string file, parsed_level &parsed) {
+    // loads a level from a level pack (see pack.cpp), preferring its compiled level.omlvl if it has one
+    // the pack's only mapped while the level's read out of it
+
+    if (get_debug()) {printf("Loading level pack: %s\n", file.c_str());}
+
+    level_pack pack;
+    const unsigned char *data;
+    size_t size;
+    bool success = false;
+
+    if (!open_level_pack(file, pack)) {
+        parsed.issues.push_back({{"type", "corrupt_pack"}});
+        return false;
+    }
+
+    if (find_pack_entry(pack, "level.omlvl", data, size)) {
+        mapped_level level;
+        level.data = data;
+        level.size = size;
+        success = read_compiled_level(level, parsed);
+    } else if (find_pack_entry(pack, "level.json", data, size)) {
+        string error;
+        success = parse_level_data(data, size, parsed.source, error);
+
+        if (success) {
+            fill_parsed_level(parsed);
+        } else {
+            printf("[!] Error parsing level file: %s\n", error.c_str());
+            parsed.issues.push_back({{"type", "parse_error"}, {"message", error}});
+        }
+    } else {
+        printf("[!] Couldn't load level pack: %s has no level in it.\n", file.c_str());
+        parsed.issues.push_back({{"type", "missing_file"}});
+    }
+
+    close_level_pack(pack);
+    return success;
+}
+
+void read_level(string file, parsed_level &parsed) {
+    // loads a level into parsed without touching the currently-loaded level, so it's safe to call from the level cache's thread
+    // if there's a compiled copy of the level (level.omlvl, see level.cpp) that's at least as new as the JSON, that's loaded instead
+    // parsed.loaded is false if the level couldn't be loaded
     // ----------------------------------------------------------
-    // opcode: single letter that represents an action (corresponding to keyboard controls)
-    // shape: the shape parameters to modify
-    // is_player: whether this modification is from the CPU or the player
+    // file: a path to a file, usually supplied by get_level_json_path() ("assets/levels/foobar/level.json")
+
+    std::filesystem::path compiled_file = std::filesystem::path(file).replace_extension(".omlvl");
+    std::filesystem::path folder = std::filesystem::path(file).parent_path();
+    std::error_code err;
 
-    shape modified_shape = current_shape;
+    parsed = parsed_level();
 
-    // check to see if the shape is visible
-    if (modified_shape.type == -1) {
-        // check to see if the opcode isnt one that makes said shape visible
-        if (opcode != 'Z' && opcode != 'X' && opcode != 'C') return modified_shape;
+    // levels packed into a single file (see pack.cpp) use the same paths as folders do, e.g. "assets/levels/foobar.ompack/level.json"
+    if (check_level_pack(folder.string())) {
+        if (!parse_level_pack(folder.string(), parsed)) {
+            json issues = parsed.issues;
+            parsed = parsed_level();
+            parsed.issues = issues;
+        }
+
+        return;
     }
 
-    if (is_player) {
-        set_character_status(opcode);
+    if (std::filesystem::exists(compiled_file, err)) {
+        bool compiled_is_current = !std::filesystem::exists(file, err) || std::filesystem::last_write_time(compiled_file, err) >= std::filesystem::last_write_time(file, err);
+
+        if (compiled_is_current) {
+            if (parse_compiled_level_file(compiled_file.string(), parsed)) {return;}
+
+            printf("[!] Falling back to %s...\n", file.c_str());
+            parsed = parsed_level();
+        }
     }
 
-    switch (opcode) {
-        // circle
-        case 'Z':
-            if (play_sound) {Mix_PlayChannel(-1, snd_circle, 0);}
-            modified_shape.type = 0;
-            modified_shape.x = 7;
-            modified_shape.y = 7;
-            modified_shape.scale = 1;
-            break;
+    if (!parse_level_json(file, parsed)) {
+        json issues = parsed.issues;
+        parsed = parsed_level();
+        parsed.issues = issues;
+    }
 
-        // square
-        case 'X':
-            if (play_sound) {Mix_PlayChannel(-1, snd_square, 0);}
-            modified_shape.type = 1;
-            modified_shape.x = 7;
-            modified_shape.y = 7;
-            modified_shape.scale = 1;
-            break;
+    return;
+}
 
-        // triangle
-        case 'C':
-            if (play_sound) {Mix_PlayChannel(-1, snd_triangle, 0);}
-            modified_shape.type = 2;
-            modified_shape.x = 7;
-            modified_shape.y = 7;
-            modified_shape.scale = 1;
-            break;
+bool apply_parsed_level(const parsed_level &parsed) {
+    // makes a level loaded by read_level() the current one; returns whether it was loaded, to be stored in level_loaded
+    level_data = parsed.info;
+    bpm = get_level_bpm();
 
-        // x-plode (essentially a NOP)
-        case 'V':
-            if (play_sound) {Mix_PlayChannel(-1, snd_xplode, 0);}
-            break;
+    if (!parsed.loaded) {
+        reset_color_table();
+        return false;
+    }
 
-        // shrink
-        case 'A':
-            if (play_sound) {Mix_PlayChannel(-1, snd_scale_down, 0);}
-            modified_shape.scale = fmax(1, modified_shape.scale - 1);
-            break;
+    for (int i = 0; i < 16; i++) {
+        set_color_table(i, parsed.palette[i]);
+    }
+
+    previous_shapes = parsed.preview_shapes;
+    schedule = parsed.schedule;
+
+    return true;
+}
+
+bool parse_level_file(string file) {
+    // loads a level and makes it the current one, filling in blanks if needed (see read_level())
+    // level select goes through the level cache instead (see request_level_select())
+    parsed_level parsed;
+    read_level(file, parsed);
+
+    return apply_parsed_level(parsed);
+}
+
+std::list<cached_level>::iterator find_cached_level(const string &path) {
+    // level_cache_mutex must be held
+    for (auto it = level_cache.begin(); it != level_cache.end(); it++) {
+        if (it->path == path) {return it;}
+    }
+
+    return level_cache.end();
+}
+
+void run_level_cache() {
+    // the level cache's worker thread; loads requested levels that aren't cached yet, one at a time
+    std::unique_lock<std::mutex> lock(level_cache_mutex);
+
+    while (level_cache_running) {
+        if (level_requests.empty()) {
+            level_cache_cv.wait(lock);
+            continue;
+        }
+
+        string path = level_requests.front();
+
+        if (find_cached_level(path) != level_cache.end()) {
+            level_requests.erase(level_requests.begin());
+            continue;
+        }
+
+        // neighbours wait until scrolling stops, so holding a direction only ever loads the levels that are actually shown
+        if (path != level_request_selected) {
+            auto prefetch_time = level_request_time + std::chrono::milliseconds(level_prefetch_delay);
+
+            if (std::chrono::steady_clock::now() < prefetch_time) {
+                level_cache_cv.wait_until(lock, prefetch_time);
+                continue;
+            }
+        }
+
+        lock.unlock();
+        parsed_level parsed;
+        read_level(path, parsed);
+        lock.lock();
+
+        auto existing = find_cached_level(path);
+        if (existing != level_cache.end()) {level_cache.erase(existing);}
+
+        level_cache.push_front({path, std::move(parsed)});
+        if (level_cache.size() > level_cache_size) {level_cache.pop_back();}
+
+        level_requests.erase(std::remove(level_requests.begin(), level_requests.end(), path), level_requests.end());
+        level_cache_cv.notify_all();
+    }
+
+    return;
+}
+
+void start_level_cache() {
+    level_cache_running = true;
+    level_cache_thread = std::thread(run_level_cache);
+    return;
+}
+
+void stop_level_cache() {
+    {
+        std::lock_guard<std::mutex> lock(level_cache_mutex);
+        level_cache_running = false;
+    }
+
+    level_cache_cv.notify_all();
+    if (level_cache_thread.joinable()) {level_cache_thread.join();}
+    return;
+}
+
+void clear_level_cache() {
+    // drops every cached level, e.g. so a level that failed to load is read from disk again
+    std::lock_guard<std::mutex> lock(level_cache_mutex);
+    level_cache.clear();
+    return;
+}
+
+void forget_cached_level(const string &path) {
+    // drops a single level from the cache, e.g. because its level.json has changed
+    std::lock_guard<std::mutex> lock(level_cache_mutex);
+    auto cached = find_cached_level(path);
+    if (cached != level_cache.end()) {level_cache.erase(cached);}
+    return;
+}
+
+bool update_level_select() {
+    // called every frame in level select; makes the selected level the current one once the cache has it
+    // returns true if the level was swapped in
+    if (!level_select_pending) {return false;}
+
+    parsed_level parsed;
+
+    {
+        std::lock_guard<std::mutex> lock(level_cache_mutex);
+        auto cached = find_cached_level(get_level_json_path());
+        if (cached == level_cache.end()) {return false;}
+
+        // moves it to the front, since it's now the most recently used
+        level_cache.splice(level_cache.begin(), level_cache, cached);
+        parsed = cached->level;
+    }
+
+    level_select_pending = false;
+    level_loaded = apply_parsed_level(parsed);
+    load_metadata();
+
+    return true;
+}
+
+void request_level_select() {
+    // asks the level cache for the selected level (level_index) and its neighbours; it's swapped in by update_level_select() once it's loaded
+    if (level_paths.empty()) {return;}
+
+    int count = level_paths.size();
+    vector<string> requests;
+
+    for (int offset: {0, -1, 1}) {
+        string path = level_paths[(level_index + offset + count) % count] + "/level.json";
+        if (std::find(requests.begin(), requests.end(), path) == requests.end()) {requests.push_back(path);}
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(level_cache_mutex);
+        level_requests = requests;
+        level_request_selected = requests[0];
+        level_request_time = std::chrono::steady_clock::now();
+    }
+
+    level_select_pending = true;
+    level_cache_cv.notify_all();
+    update_level_select();
+
+    return;
+}
+
+void load_level_select() {
+    // same as request_level_select(), but waits for the selected level to be loaded; used when entering level select
+    request_level_select();
+    if (!level_select_pending) {return;}
+
+    {
+        std::unique_lock<std::mutex> lock(level_cache_mutex);
+        level_cache_cv.wait(lock, []{return find_cached_level(level_request_selected) != level_cache.end();});
+    }
+
+    update_level_select();
+    return;
+}
 
-        // grow
-        case 'S':
-            if (play_sound) {Mix_PlayChannel(-1, snd_scale_up, 0);}
-            modified_shape.scale = fmin(8, modified_shape.scale + 1);
+json validate_level(const string &path) {
+    // checks a single level folder, returning its entry for the validation report (see validate_levels())
+    // compiled levels were already checked when they were compiled, so they're only checked if there's no level.json to check instead
+    parsed_level parsed;
+    std::filesystem::path file = std::filesystem::path(path) / "level.json";
+    std::error_code err;
+
+    if (check_level_pack(path)) {
+        parse_level_pack(path, parsed);
+    } else if (std::filesystem::exists(file, err)) {
+        parse_level_json(file.string(), parsed);
+    } else if (!parse_compiled_level_file(file.replace_extension(".omlvl").string(), parsed)) {
+        parsed.issues.push_back({{"type", "corrupt_compiled_level"}});
+    }
+
+    return {{"path", path}, {"name", parsed.info.name}, {"issues", parsed.issues}};
+}
+
+int validate_levels(string report_path) {
+    // validates every level found by load_levels() on a pool of threads (one per core), then writes a JSON report to report_path
+    // the report lists every level with at least one issue; returns how many of those there were
+
+    int level_count = level_paths.size();
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    vector<json> results(level_count);
+    vector<std::thread> threads;
+    std::atomic<int> next_level{0};
+
+    printf("Validating %i level(s) on %i thread(s)...\n", level_count, thread_count);
+
+    // each thread takes the next unchecked level until there aren't any left, so a few slow levels don't hold the rest up
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&]() {
+            for (int i = next_level++; i < level_count; i = next_level++) {
+                results[i] = validate_level(level_paths[i]);
+            }
+        });
+    }
+
+    for (int t = 0; t < thread_count; t++) {
+        threads[t].join();
+    }
+
+    json report = {{"level_count", level_count}, {"levels", json::array()}};
+
+    for (int i = 0; i < level_count; i++) {
+        if (results[i]["issues"].empty()) {continue;}
+        report["levels"].push_back(results[i]);
+    }
+
+    int problem_count = report["levels"].size();
+    report["levels_with_issues"] = problem_count;
+
+    std::ofstream file(report_path);
+    file << report.dump(4);
+
+    printf("Validation finished: %i of %i level(s) have issues (see %s).\n", problem_count, level_count, report_path.c_str());
+    return problem_count;
+}
+
+bool compile_level(string path) {
+    // compiles a level folder (or its level.json) into a level.omlvl next to it; used by the -compile-level option
+    // the level goes through the regular JSON parser first, so the compiled copy has the same fixes applied to it
+
+    std::filesystem::path file = path;
+    if (std::filesystem::is_directory(file)) {file /= "level.json";}
+
+    printf("Compiling level: %s\n", file.string().c_str());
+
+    parsed_level parsed;
+    if (!parse_level_json(file.string(), parsed)) {return false;}
+
+    unsigned char palette[16][4];
+
+    for (int i = 0; i < 16; i++) {
+        palette[i][0] = parsed.palette[i].r;
+        palette[i][1] = parsed.palette[i].g;
+        palette[i][2] = parsed.palette[i].b;
+        palette[i][3] = parsed.palette[i].a;
+    }
+
+    return compile_level_file(parsed.source, palette, file.replace_extension(".omlvl").string());
+}
+
+bool pack_level(string path) {
+    // packs a level folder into a level pack next to it (e.g. "assets/levels/foobar" into "assets/levels/foobar.ompack"); used by the -pack-level option
+    // if the folder's been compiled first (see compile_level()), its level.omlvl goes in the pack too, and is what gets loaded from it
+    std::filesystem::path folder = std::filesystem::path(path).lexically_normal();
+    if (!folder.has_filename()) {folder = folder.parent_path();}
+
+    if (!std::filesystem::is_directory(folder)) {
+        printf("[!] Couldn't pack level: %s isn't a folder.\n", path.c_str());
+        return false;
+    }
+
+    printf("Packing level: %s\n", folder.string().c_str());
+    return build_level_pack(folder.string(), folder.string() + ".ompack");
+}
+
+char get_button_op(controller_buttons input_value) {
+    // returns the op an in-game button press corresponds to (see apply_shape_op()), or '.' if there isn't one
+    switch(input_value) {
+        case UP: return 'U';
+        case DOWN: return 'D';
+        case LEFT: return 'L';
+        case RIGHT: return 'R';
+        case CIRCLE: return 'Z';
+        case SQUARE: return 'X';
+        case TRIANGLE: return 'C';
+        case CROSS: return 'V';
+        case LB: return 'A';
+        case RB: return 'S';
+        default: return '.';
+    }
+}
+
+bool push_game_input(core_input input) {
+    // adds a press to the input queue; only ever called from the main thread
+    int head = input_queue_head.load(std::memory_order_relaxed);
+    int next = (head + 1) % input_queue_size;
+
+    if (next == input_queue_tail.load(std::memory_order_acquire)) {return false;}
+
+    input_queue[head] = input;
+    input_queue_head.store(next, std::memory_order_release);
+    return true;
+}
+
+bool pop_game_input(core_input &input) {
+    // takes the oldest press from the input queue; only ever called from the simulation thread
+    int tail = input_queue_tail.load(std::memory_order_relaxed);
+
+    if (tail == input_queue_head.load(std::memory_order_acquire)) {return false;}
+
+    input = input_queue[tail];
+    input_queue_tail.store((tail + 1) % input_queue_size, std::memory_order_release);
+    return true;
+}
+
+int game_input_watch(void *userdata, SDL_Event *event) {
+    // event watch that stamps in-game presses with the song clock as soon as SDL receives them, then queues them for the simulation thread
+    // this way presses are judged at the time they happened, rather than whenever the next frame gets around to them
+    // event watches are called from inside SDL_PumpEvents(), so this runs on the main thread
+    // the calibration screen gets its taps from here as well, for the same reason
+    if (!(sim_running || calibration_active) || check_fade_activity()) {return 1;}
+    if (sim_running && render_snapshot.game_over) {return 1;}
+
+    controller_buttons input_value = NONE;
+
+    // key repeats are ignored, so a player cant just hold a key to "buffer" inputs
+    if (event->type == SDL_KEYDOWN && event->key.repeat == 0) {
+        input_value = keyboard_to_abstract_button(event->key.keysym.sym, true);
+    }
+
+    if (event->type == SDL_CONTROLLERBUTTONDOWN) {
+        input_value = gamepad_to_abstract_button(event->cbutton.button);
+    }
+
+    // menu buttons are handled by the main event loop instead
+    char op = get_button_op(input_value);
+    if (op == '.') {return 1;}
+
+    if (calibration_active) {
+        calibration_tap(get_song_clock());
+        return 1;
+    }
+
+    // the audio offset is taken off so presses are judged against when the player actually heard the beat
+    if (!push_game_input({op, get_song_clock() - audio_offset})) {
+        printf("[!] Input queue is full, dropping input!\n");
+    }
+
+    return 1;
+}
+
+void handle_core_event(const core_event &event) {
+    // turns something that happened during core_step() into sounds, rumble, etc.; called from loop()
+    switch (event.type) {
+        case CORE_BEAT:
+            // plays metronome sounds
+            if (get_debug()) {
+                if ((event.value - schedule.start_offset)%schedule.time_signature_top == 0) {
+                    Mix_PlayChannel(1, snd_metronome_big, 0);
+                } else {
+                    Mix_PlayChannel(1, snd_metronome_small, 0);
+                }
+            }
+
+            beat_advanced = true;
             break;
 
-        // up
-        case 'U':
-            if (play_sound) {Mix_PlayChannel(-1, snd_up, 0);}
-            modified_shape.y = fmax(modified_shape.y - 1, 0);
+        case CORE_CPU_OP:
+            play_op_sound(event.op);
             break;
 
-        // down
-        case 'D':
-            if (play_sound) {Mix_PlayChannel(-1, snd_down, 0);}
-            modified_shape.y = fmin(modified_shape.y + 1, 14);
+        case CORE_PLAYER_OP:
+            set_character_timer(60000/bpm);
+
+            if (event.value) {
+                set_character_status(event.op);
+                play_op_sound(event.op);
+            }
+
             break;
 
-        // left
-        case 'L':
-            if (play_sound) {Mix_PlayChannel(-1, snd_left, 0);}
-            modified_shape.x = fmax(modified_shape.x - 1, 0);
+        case CORE_SHAPE_CLEARED:
+            shape_advanced = true;
             break;
 
-        // right
-        case 'R':
-            if (play_sound) {Mix_PlayChannel(-1, snd_right, 0);}
-            modified_shape.x = fmin(modified_shape.x + 1, 14);
+        case CORE_COMBO:
+            Mix_PlayChannel(-1, snd_combo, 0);
+            combo_triggered = true;
             break;
 
-        // no-op
-        case '.':
+        // the core runs audio_offset behind the song (see loop()), so that's added back on to keep the song where it already is
+        case CORE_SEEK:
+            seek_stage_music(fmax(event.value * schedule.beat_length_seconds + audio_offset / 1000.0, 0));
             break;
 
-        default: break;
-    }
+        case CORE_PHASE_SWAP:
+            reset_character_status();
+            break;
 
-    return modified_shape;
-}
+        case CORE_RUMBLE:
+            rumble_controller();
+            break;
 
-void morph_shapes() {
-    for (int i = 0; i < previous_shapes.size(); i++) {
-        int new_type = (previous_shapes[i].type + 1) % 3;
-        previous_shapes[i].type = new_type;
-    }
-    return;
-}
+        case CORE_GAME_OVER:
+            printf("Game over!\n");
+            fade_out_stage_music(5000);
+            break;
 
-void morph_colors() {
-    for (int i = 0; i < previous_shapes.size(); i++) {
-        // skip any shapes with the erase color
-        if (previous_shapes[i].color == 16) {continue;}
+        case CORE_SONG_OVER:
+            printf("End of level reached.\n");
+            metadata.cleared = true;
+            break;
 
-        int new_color = (previous_shapes[i].color + 1) % 16;
-        previous_shapes[i].color = new_color;
+        // the render thread takes care of actually leaving the level (see main())
+        default: break;
     }
+
     return;
 }
 
-bool check_available_sequence(int beat_side) {
-    // returns true if the current sequence op is blank, false if it isn't
-    // this ensures that both a sequence can't be overwritten and that
-    // only ONE input is registered, preventing "diagonals" for example
-    // ----------------------------------------------------------
-    // beat_side: returned from check_beat_timing_window(); 1 = beat end, 2 = beat start
-
-    int measure_length = get_level_measure_length();
-    int start_offset = get_level_intro_delay();
-    int current_beat_count = (beat_count - start_offset) % measure_length;
+// reused between ticks so loop() doesn't allocate
+vector<core_input> step_inputs;
+vector<core_event> step_events;
 
-    int index = 0;
-    string sequence = get_player_sequence();
+bool loop(int frame_time) {
+    // main gameplay loop, runs every simulation tick during GAME (see run_simulation())
+    // the rules themselves live in the core (see core.cpp); this feeds it the song clock and queued presses, then acts on what happened
+    // beats are timed against the song clock so they stay in sync with the audio being played
+    // the audio offset is taken off, so beats are processed on the same clock presses are stamped with (see game_input_watch())
+    core_input input;
 
-    if (beat_side == 0) {return false;}
-    if (beat_side == 1) {index = current_beat_count - 1;}
-    if (beat_side == 2) {index = current_beat_count;}
-
-    if (index <= 0) {index = 0;}
-    if (index >= measure_length) {index = measure_length;}
+    // reset BG flags to false
+    beat_advanced = false;
+    shape_advanced = false;
 
-    if (sequence[index] == '.') {return true;}
+    step_inputs.clear();
+    step_events.clear();
 
-    return false;
-}
+    while (pop_game_input(input)) {step_inputs.push_back(input);}
 
-string modify_sequence(char opcode, int beat_side) {
-    // records the player's moves to the player sequence
-    // ----------------------------------------------------------
-    // opcode: single letter that represents an action (see modify_current_shape())
-    // beat_side: returned from check_beat_timing_window(); 1 = beat end, 2 = beat start
+    int beats_processed = core_step(game, schedule, get_song_clock() - audio_offset, step_inputs, step_events);
 
-    int measure_length = get_level_measure_length();
-    int start_offset = get_level_intro_delay();
-    int current_beat_count = (beat_count - start_offset) % measure_length;
+    if (beats_processed > 1 && get_debug()) {printf("Tick stalled, caught up %i beat(s).\n", beats_processed - 1);}
 
-    int index = 0;
-    string sequence = get_player_sequence();
+    for (int i = 0; i < step_events.size(); i++) {
+        handle_core_event(step_events[i]);
+    }
 
-    if (beat_side == 0) {return sequence;}
-    if (beat_side == 1) {index = current_beat_count - 1;}
-    if (beat_side == 2) {index = current_beat_count;}
+    // locks off the character when lives are 0
+    if (game.game_over == false) {tick_character(frame_time);}
 
-    if (index <= 0) {index = 0;}
-    if (index >= measure_length) {index = measure_length;}
+    return true;
+}
 
-    sequence[index] = opcode;
+void publish_snapshot() {
+    // copies the gameplay state for the render thread; game_mutex must be held
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+
+    published_snapshot.beat_count = game.beat_count;
+    published_snapshot.beat_start_time = game.beat_start_time;
+    published_snapshot.beat_length = game.beat_length;
+    published_snapshot.active_shape = game.active_shape;
+    published_snapshot.result_shape = game.result_shape;
+    published_snapshot.previous_shapes = game.previous_shapes;
+    published_snapshot.cpu_sequence = game.cpu_sequence;
+    published_snapshot.player_sequence = game.player_sequence;
+    published_snapshot.score = game.score;
+    published_snapshot.life = game.life;
+    published_snapshot.combo = game.combo;
+    published_snapshot.song_over = game.song_over;
+    published_snapshot.game_over = game.game_over;
+    published_snapshot.level_finished = game.level_finished;
+
+    // these only last a single tick, so they're held until the render thread sees them
+    published_snapshot.beat_advanced |= beat_advanced;
+    published_snapshot.shape_advanced |= shape_advanced;
+    published_snapshot.combo_triggered |= combo_triggered;
+    combo_triggered = false;
 
-    return sequence;
+    return;
 }
 
-bool check_sequence_validity(string sequence, shape shape_result) {
-    // checks to see if a given sequence actually becomes the shape it corresponds to
-    // used in parse_level_file() below
-
-    // create blank shape to run sequence on
-    shape shape_test = {
-        -1,
-        7,
-        7,
-        1,
-        0
-    };
+void take_snapshot() {
+    // copies the latest published snapshot into render_snapshot, called once per frame by the render thread
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
 
-    // run sequence on shape
-    for (int i = 0; i < sequence.length(); i++) {
-        char op = sequence[i];
-        shape_test = modify_current_shape(op, shape_test, false, false);
-    }
+    render_snapshot = published_snapshot;
+    published_snapshot.beat_advanced = false;
+    published_snapshot.shape_advanced = false;
+    published_snapshot.combo_triggered = false;
 
-    if (get_debug()) {printf("shape_test: %i %i %i %i \nexpected: %i %i %i %i \n", shape_test.type, shape_test.x, shape_test.y, shape_test.scale, shape_result.type, shape_result.x, shape_result.y, shape_result.scale);}
-    return compare_shapes(shape_result, shape_test);
+    return;
 }
 
-json parse_level_file(string file) {
-    // loads a JSON file and parses it, filling in blanks if needed; called every time a new level is hovered over via level select
-    // ----------------------------------------------------------
-    // file: a path to a file, usually supplied by get_level_json_path() ("assets/levels/foobar/level.json")
+void run_simulation() {
+    // gameplay thread; runs loop() at a fixed rate (sim_rate) while a level is being played
+    // this keeps beat processing and judgement independent of how long a frame takes to render
+    auto tick_length = std::chrono::microseconds(1000000 / sim_rate);
+    auto next_tick = std::chrono::steady_clock::now();
+    double last_tick_time = get_time_ms();
+    double elapsed = 0;
 
-    if (get_debug()) {printf("Parsing level file: %s\n", file.c_str());}
+    while (sim_running) {
+        // tick_character() only works in whole milliseconds, so the remainder is carried over to the next tick
+        double current_time = get_time_ms();
+        elapsed += current_time - last_tick_time;
+        last_tick_time = current_time;
 
-    std::ifstream ifs(file);
-    json parsed_json;
+        int tick_time = elapsed;
+        elapsed -= tick_time;
 
-    // checks to make sure the file exists
-    if (std::filesystem::exists(file) == false) {
-        printf("[!] Couldn't parse level file: Does not exist.\n");
-        return NULL;
-    }
+        {
+            std::lock_guard<std::mutex> lock(game_mutex);
+            loop(tick_time);
+            publish_snapshot();
+        }
 
-    // checks to see if the JSON is valid JSON
-    try {
-        parsed_json = json::parse(ifs);
-    } catch(json::parse_error& err) {
-        printf("[!] Error parsing level file: %s\n", err.what());
-        return NULL;
+        // if we've fallen behind, don't try to run all the missed ticks; loop() already catches up on beats by itself
+        next_tick += tick_length;
+        auto now = std::chrono::steady_clock::now();
+        if (next_tick < now) {next_tick = now;}
+
+        std::this_thread::sleep_until(next_tick);
     }
 
-    // sets the current JSON to json_file, done to make get_level_bpm etc. function
-    // (this is a janky workaround; TODO: rewrite the get_level_ functions so this isn't necessary anymore)
-    json_file = parsed_json;
-    bpm = get_level_bpm();
+    return;
+}
 
-    // checks to see if a color_table exists, and if it does, try to load it
-    reset_color_table();
+void start_simulation() {
+    // starts the gameplay thread; all gameplay state should be set up beforehand
+    if (sim_running) {return;}
 
-    if (parsed_json[0].contains("color_table")) {
-        if (get_debug()) {printf("Parsing color table...\n");}
+    beat_advanced = false;
+    shape_advanced = false;
+    combo_triggered = false;
 
-        for (int i = 0; i < 16; i++) {
-            if (parsed_json[0]["color_table"][i] == NULL) {continue;}
-            if (parsed_json[0]["color_table"][i].is_string() == false) {continue;}
+    // throws out any presses left over from the last level
+    input_queue_tail = input_queue_head.load();
 
-            set_color_table(i, parsed_json[0]["color_table"][i]);
-        }
+    {
+        std::lock_guard<std::mutex> lock(game_mutex);
+        publish_snapshot();
     }
 
-    // this entire block generates sequences if they aren't present
-    // note that we generate these even if they're already present in order to ensure a level is actually beatable
-    // it also uses this opportunity to populate previous_shapes for the level select menu
-
-    int max_sequence_length = get_level_measure_length();
-    previous_shapes.clear();
-
-    for (int i = 1; i < parsed_json.size(); i++) {
-        int shape_type = parsed_json[i].value("shape", 0);
-        int x = parsed_json[i].value("x", 7);
-        int y = parsed_json[i].value("y", 7);
-        int scale = parsed_json[i].value("scale", 1);
+    take_snapshot();
 
-        bool sequence_exists = parsed_json[i].contains("sequence");
-        string gen_sequence;
-
-        // populates the previous_shapes struct
-        // used for displaying the full face in the level select
-        shape s = {
-            shape_type,
-            x,
-            y,
-            scale,
-            parsed_json[i].value("color", 0)
-        };
-
-        previous_shapes.push_back(s);
-
-        if (parsed_json[i].contains("auto_shapes") && parsed_json[i]["auto_shapes"].is_array()) {
-            for (int j = 0; j < parsed_json[i]["auto_shapes"].size(); j++) {
-                s = {
-                    parsed_json[i]["auto_shapes"][j].value("shape", 0),
-                    parsed_json[i]["auto_shapes"][j].value("x", 7),
-                    parsed_json[i]["auto_shapes"][j].value("y", 7),
-                    parsed_json[i]["auto_shapes"][j].value("scale", 1),
-                    parsed_json[i]["auto_shapes"][j].value("color", 0)
-                };
-
-                previous_shapes.push_back(s);
-            }
-        }
+    sim_running = true;
+    sim_thread = std::thread(run_simulation);
+    return;
+}
 
-        // sets the first action to changing shape
-        switch (shape_type) {
-            case 0: gen_sequence += "Z"; break;
-            case 1: gen_sequence += "X"; break;
-            case 2: gen_sequence += "C"; break;
-            default: gen_sequence += "Z"; break;
-        }
+void stop_simulation() {
+    // stops the gameplay thread and waits for it to finish
+    if (!sim_running) {return;}
 
-        // scales up the shape to the needed size
-        if (scale > 1) {
-            for (int j = 1; j < scale; j++) {gen_sequence += "S";}
-        }
+    sim_running = false;
+    sim_thread.join();
+    return;
+}
 
-        // moves across the X axis
-        if (x > 7) {
-            for (int j = 7; j < x; j++) {gen_sequence += "R";}
-        }
+void get_visual_beat(double ticks, int &beat_count, double &beat_start_time) {
+    // moves the simulation's latest beat to wherever it is at ticks, so what's drawn lines up with what the player hears (see audio_offset)
+    // beats are evenly spaced, so this just steps back (or forwards) one beat at a time
+    while (beat_start_time > ticks && beat_count > 0) {
+        beat_start_time -= render_snapshot.beat_length;
+        beat_count--;
+    }
 
-        if (x < 7) {
-            for (int j = 7; j > x; j--) {gen_sequence += "L";}
-        }
+    // the simulation stops advancing beats on a game over, so these shouldn't either
+    while (render_snapshot.game_over == false && ticks - beat_start_time >= render_snapshot.beat_length) {
+        beat_start_time += render_snapshot.beat_length;
+        beat_count++;
+    }
 
-        // moves across the Y axis
-        if (y > 7) {
-            for (int j = 7; j < y; j++) {gen_sequence += "D";}
-        }
+    return;
+}
 
-        if (y < 7) {
-            for (int j = 7; j > y; j--) {gen_sequence += "U";}
-        }
+// hot reloading: the current level's folder is watched while it's selected or being played (see watcher.cpp)
+// any file that changes is reloaded by itself, without restarting the level or reloading anything else
+// ----------------------------------------------------------
+// hot_reload_files: changed files, waiting for the next beat so they're swapped in on time with the music
+// hot_reload_level: the changed level, already parsed, waiting for a point where its schedule can be swapped in (see swap_hot_reload_level())
+vector<string> hot_reload_files;
+parsed_level hot_reload_level;
+bool hot_reload_level_pending = false;
 
-        // checks to see if the gen_sequence can fit within the allotted number of beats
-        if (gen_sequence.length() > max_sequence_length) {
-            printf("[!] Generated sequence #%i is longer than max number of beats! Level is not winnable.\n", i);
-        }
+void watch_current_level() {
+    // keeps the watcher on the selected level; level packs aren't watched, since they're meant for finished levels
+    if (level_paths.empty() || check_level_pack(level_paths[level_index])) {
+        stop_watching_level();
+        return;
+    }
 
-        // pads the sequence with NOPs
-        if (gen_sequence.length() < max_sequence_length) {
-            gen_sequence.insert(gen_sequence.end(), max_sequence_length - gen_sequence.length(), '.');
-        }
+    watch_level_folder(level_paths[level_index]);
+    return;
+}
 
-        if (get_debug()) {printf("gen_seq: %s\n", gen_sequence.c_str());}
+void reset_hot_reload() {
+    // throws out anything waiting to be reloaded; used when a level is loaded from scratch anyway
+    vector<string> changed;
+    poll_level_changes(changed);
 
-        // check if a sequence is defined for this shape, if not, use the generated one
-        // checking this AFTER making a sequence is inefficient, but also makes it much
-        // more likely to catch impossible levels and is negligible on performance
-        if (sequence_exists) {
-            string cur_sequence = parsed_json[i].value("sequence", ".");
-            if (get_debug()) {printf("cur_seq: %s\n", cur_sequence.c_str());}
-            int cur_seq_length = cur_sequence.length(); // fixes GCC warning
+    hot_reload_files.clear();
+    hot_reload_level_pending = false;
+    return;
+}
 
-            // similar to the above checks for generated sequences
-            if (cur_seq_length > max_sequence_length) {
-                printf("Level sequence #%i is too long (must be %i, is %i)! Truncating...\n", i, max_sequence_length, cur_seq_length);
-                parsed_json[i]["sequence"] = cur_sequence.substr(0, max_sequence_length);
-            }
+bool prepare_hot_reload_level() {
+    // parses the changed level and checks that it can be swapped into the one being played
+    // anything that moves where the beats are (bpm, time signature, measure length, offset) only takes effect on a restart
+    read_level(get_level_json_path(), hot_reload_level);
 
-            if (cur_seq_length < max_sequence_length) {
-                printf("Level sequence #%i is too short (must be %i, is %i)! Padding...\n", i, max_sequence_length, cur_seq_length);
-                parsed_json[i]["sequence"] = cur_sequence.insert(cur_sequence.end(), max_sequence_length - cur_seq_length, '.');
-            }
+    if (!hot_reload_level.loaded) {
+        printf("[!] Changed level couldn't be loaded, keeping the old one.\n");
+        return false;
+    }
 
-            // we create a new shape here since s has been used for auto_shapes earlier
-            if (!check_sequence_validity(cur_sequence, {shape_type, x, y, scale, 0})) {
-                printf("[!] Sequence #%i does not match expected shape, using fallback...\n", i);
-                parsed_json[i]["sequence"] = gen_sequence;
-            }
+    const level_schedule &next = hot_reload_level.schedule;
 
-            continue;
-        } else {
-            parsed_json[i]["sequence"] = gen_sequence;
-        }
+    if (next.bpm != schedule.bpm || next.time_signature_top != schedule.time_signature_top || next.time_signature_bottom != schedule.time_signature_bottom ||
+        next.measure_length != schedule.measure_length || next.start_offset != schedule.start_offset) {
+        printf("[!] Level timing has changed, restart the level to see it.\n");
+        return false;
     }
 
-    return parsed_json;
+    return true;
 }
 
-bool loop(json json_file, int start_offset, int time_signature_top, int time_signature_bottom, int song_start_time, int frame_time) {
-    // main gameplay loop, runs every frame during GAME
-    int current_ticks = SDL_GetTicks();
-    int measure_length = time_signature_top * time_signature_bottom;
-    int shape_count = (beat_count - start_offset)/(measure_length*2);
-
-    // reset BG flags to false
-    beat_advanced = false;
-    shape_advanced = false;
+bool swap_hot_reload_level() {
+    // swaps the changed level in, but only where the CPU's ops for the current shape are either all done or not started yet
+    // i.e. during the intro, on the first beat of a shape, or during the player's half of one; returns false if it has to wait
+    bool effect_changed;
 
-    // locks off loop when lives are 0
-    if (game_over == false) {
-        if ((current_ticks - beat_start_time) >= length) {
+    {
+        std::lock_guard<std::mutex> lock(game_mutex);
+        int cycle_length = schedule.measure_length * 2;
+        int position = game.beat_count - schedule.start_offset;
 
-            // plays metronome sounds
-            if (get_debug()) {
-                if ((beat_count - start_offset)%time_signature_top == 0) {
-                    Mix_PlayChannel(1, snd_metronome_big, 0);
-                } else {
-                    Mix_PlayChannel(1, snd_metronome_small, 0);
-                }
-            }
+        if (position >= 0 && position % cycle_length != 0 && position % cycle_length < schedule.measure_length) {return false;}
 
-            // waits until the song's reached past the intro
-            if (song_over == false && beat_count >= start_offset) {
+        if (game.song_over || (position >= 0 && position / cycle_length + 1 > hot_reload_level.schedule.total_shapes)) {
+            printf("[!] Level has changed before the current shape, restart the level to see it.\n");
+            hot_reload_level_pending = false;
+            return true;
+        }
 
-                // triggers at the start of every shape (a.k.a, the start of every CPU/player phase)
-                if ((beat_count - start_offset)%(measure_length*2) == 0) {
-                    if (beat_count == start_offset) {
-                        song_beat_position = beat_count;
-                    } else {
-                        int song_step_amount = get_song_step((beat_count - (start_offset + 1))/(measure_length*2) + 1, measure_length*2);
-
-                        if (compare_shapes(active_shape, result_shape) == true) {
-                            // reward player with life and points
-                            modify_life(5);
-                            combo++;
-                            score += (calculate_score() * combo);
-
-                            // triggers the combo effect when reaching multiples of 5
-                            if (combo%5 == 0) {
-                                Mix_PlayChannel(-1, snd_combo, 0);
-                                set_combo_timer(3000);
-                            }
+        effect_changed = hot_reload_level.info.background_effect != level_data.background_effect;
+        level_loaded = apply_parsed_level(hot_reload_level);
+    }
 
-                            // advances the song
-                            float timer = (song_beat_position + song_step_amount) * ((60.f/bpm * 2.f) / time_signature_bottom);
-                            Mix_SetMusicPosition(timer);
-                            song_beat_position += song_step_amount;
-                            shape_advanced = true;
+    hot_reload_level_pending = false;
+    printf("Reloaded level: %s\n", get_level_json_path().c_str());
 
-                            // pushes shapes to vector for drawing
-                            active_shape.color = json_file[shape_count].value("color", 0);
-                            previous_shapes.push_back(active_shape);
+    if (effect_changed) {init_background_effect();}
+    return true;
+}
 
-                            // pushes auto_shapes as well, if present
-                            if (json_file[shape_count].contains("auto_shapes") && json_file[shape_count]["auto_shapes"].is_array()) {
-                                if (get_debug()) {printf("Pushing auto-shapes to shape draw queue...\n");}
+void reload_level_file(const string &name) {
+    // reloads a single one of the current level's files while it's being played (anything but the level itself; see above)
+    printf("Reloading %s...\n", name.c_str());
 
-                                for (int i = 0; i < json_file[shape_count]["auto_shapes"].size(); i++) {
-                                    shape temp;
+    if (name == "tile.png") {
+        reload_background_tileset();
+        return;
+    }
 
-                                    temp.type   = json_file[shape_count]["auto_shapes"][i].value("shape", 0);
-                                    temp.x      = json_file[shape_count]["auto_shapes"][i].value("x", 7);
-                                    temp.y      = json_file[shape_count]["auto_shapes"][i].value("y", 7);
-                                    temp.scale  = json_file[shape_count]["auto_shapes"][i].value("scale", 1);
-                                    temp.color  = json_file[shape_count]["auto_shapes"][i].value("color", 0);
+    if (name == "tile.json") {
+        if (get_level_background_effect_string() == "tile") {load_tile_frame_file();}
+        return;
+    }
 
-                                    previous_shapes.push_back(temp);
-                                }
-                            }
-                        } else {
-                            // resets the song back to where it goes
-                            float timer = song_beat_position * ((60.f/bpm * 2.f) / time_signature_bottom);
-                            Mix_SetMusicPosition(timer);
-                            beat_count -= measure_length*2;
+    if (name == "character.json") {
+        unload_character_tileset();
+        load_character_file();
+        return;
+    }
 
-                            // re-calculates shape_count for cpu_sequence below
-                            shape_count = (beat_count - start_offset)/(measure_length*2);
+    if (name == "character.png") {
+        unload_character_tileset();
+        load_character_tileset();
+        return;
+    }
 
-                            // penalize player's life and combo
-                            modify_life(-25);
-                            combo = 0;
-                        }
-                    }
+    if (name == "song.ogg") {
+        printf("[!] The song can't be swapped while it's playing, restart the level to hear it.\n");
+        return;
+    }
 
-                    // are we dead yet?
-                    if (life == 0) {
-                        printf("Game over!\n");
-                        Mix_FadeOutMusic(5000);
-                        game_over = true;
-                    }
+    std::filesystem::path file = name;
+    Mix_Chunk **sound = get_stage_sound(file.stem().string());
 
-                    reset_shapes();
-                    reset_sequences();
-                    cpu_sequence = json_file[fmin(shape_count + 1, json_file.size() - 1)].value("sequence", ".");
-                }
+    // the simulation thread plays these while holding game_mutex, so the new sound's loaded first and only swapped in under it
+    if (file.extension() == ".ogg" && sound != NULL) {
+        Mix_Chunk *new_sound = load_stage_sound(file.stem().string());
+        std::lock_guard<std::mutex> lock(game_mutex);
 
-                // triggers at the start of every swap between CPU and player
-                if ((beat_count - start_offset) % measure_length == 0) {
-                    reset_character_status();
-                }
+        Mix_FreeChunk(*sound);
+        *sound = new_sound;
+    }
 
-                // triggers for every beat where the player has control
-                if ((beat_count - start_offset) % (measure_length*2) >= measure_length) {
-                    if (beat_count%2 == 0) {rumble_controller();}
-                }
+    return;
+}
 
-                // triggers for every beat where the CPU has control
-                if ((beat_count - start_offset) % (measure_length*2) < measure_length) {
-                    int string_index = (((beat_count) - (start_offset))/(measure_length*2)) + 1;
+void update_hot_reload(bool in_game) {
+    // called every frame in level select and while playing; picks up changes to the current level's files and reloads them
+    // level select only shows the level itself, so that's all that gets reloaded there
+    vector<string> changed;
 
-                    if (string_index <= json_file.size() - 1) {
-                        // gets current position in sequence, performs action on shape
-                        int index = ((beat_count + 1) - (start_offset + 1)) % measure_length;
-                        char current_sequence_pos = cpu_sequence[index];
+    watch_current_level();
+    poll_level_changes(changed);
 
-                        // check to ensure we aren't reading out-of-bounds of the string
-                        // also checks to make sure the game isn't over
-                        if (index <= measure_length && game_over == false) {
-                            result_shape = modify_current_shape(current_sequence_pos, result_shape);
-                        }
-                    }
-                }
-            }
+    for (int i = 0; i < changed.size(); i++) {
+        bool level_changed = changed[i] == "level.json" || changed[i] == "level.omlvl";
 
-            beat_advanced = true;
-            beat_count++;
-            beat_start_time += length;
+        if (level_changed) {
+            printf("Level file changed: %s\n", changed[i].c_str());
+            forget_cached_level(get_level_json_path());
         }
 
-        tick_character(frame_time);
-
-        // this basically just says "give us 0 if it's negative, otherwise give us how many shapes have passed"
-        // this gets offset by 1 since element 0 in level.json is a header
-        shape_count = ((beat_count - start_offset) < 0) ? 0: (beat_count - (start_offset + 1))/(measure_length*2) + 1;
+        if (!in_game) {
+            if (level_changed) {request_level_select();}
+            continue;
+        }
 
-        if (shape_count > json_file.size() - 1) {
+        if (level_changed) {
+            hot_reload_level_pending = prepare_hot_reload_level();
+        } else if (std::find(hot_reload_files.begin(), hot_reload_files.end(), changed[i]) == hot_reload_files.end()) {
+            hot_reload_files.push_back(changed[i]);
+        }
+    }
 
-            if (song_over == false) {
-                printf("End of level reached.\n");
-                song_over = true;
-                metadata.cleared = true;
-            }
+    if (!in_game) {return;}
 
-            if (shape_count >= json_file.size() + 2 && check_fade_activity() == false) {
-                save_metadata();
-                printf("Ending level...\n");
-                fade_out++;
-            }
+    if (hot_reload_level_pending) {swap_hot_reload_level();}
 
-            shape_count = json_file.size();
+    if (!hot_reload_files.empty() && render_snapshot.beat_advanced) {
+        for (int i = 0; i < hot_reload_files.size(); i++) {
+            reload_level_file(hot_reload_files[i]);
         }
+
+        hot_reload_files.clear();
     }
 
-    return true;
+    return;
 }
 
 void start_level() {
     Mix_HaltMusic();
-    reset_shapes();
-    reset_sequences();
-    reset_score_and_life();
+    set_combo_timer(0);
     reset_character_status();
     unload_character_tileset();
 
+    // streamed music reads out of the level's files as it plays, so it has to go before the previous level's pack is closed
+    // everything else (sounds, the decoded song, textures) is copied out on load
+    Mix_FreeMusic(music);
+    music = NULL;
+    close_level_pack(current_pack);
+
+    if (check_level_pack(level_paths[level_index]) && !open_level_pack(level_paths[level_index], current_pack)) {
+        printf("[!] Couldn't open level pack: %s\n", level_paths[level_index].c_str());
+    }
+
     printf("Loading level: %s\n", get_level_json_path().c_str());
+    reset_hot_reload();
     draw_loading(false);
     load_stage_music();
     load_stage_sound_collection();
@@ -2284,6 +3137,17 @@ int main(int argc, char *argv[]) {
     if (parse_option(argv, argv+argc, "-help") || parse_option(argv, argv+argc, "-h")) {print_help(); return 0;}
     if (parse_option(argv, argv+argc, "-log")  || parse_option(argv, argv+argc, "-l")) {freopen("log.txt", "w", stdout);}
 
+    char *opt_compile_level = parse_option_value(argv, argv+argc, "-compile-level");
+    if (opt_compile_level) {return compile_level(opt_compile_level) ? 0 : 1;}
+
+    char *opt_pack_level = parse_option_value(argv, argv+argc, "-pack-level");
+    if (opt_pack_level) {return pack_level(opt_pack_level) ? 0 : 1;}
+
+    if (parse_option(argv, argv+argc, "-validate-levels")) {
+        load_levels();
+        return validate_levels("level_report.json") > 0 ? 1 : 0;
+    }
+
     if (!init(argc, argv)) return 1;
 
     // current_state is self explanatory
@@ -2304,7 +3168,7 @@ int main(int argc, char *argv[]) {
         // Load the level
         level_paths.push_back(startup_level);
         level_playlists.push_back("");
-        json_file = parse_level_file(get_level_json_path());
+        level_loaded = parse_level_file(get_level_json_path());
 
         start_level();
         previous_shapes.clear();
@@ -2312,6 +3176,8 @@ int main(int argc, char *argv[]) {
         fade_out = 255;
     } else {
         load_levels();
+
+        if (parse_option(argv, argv+argc, "-validate")) {validate_levels("level_report.json");}
     }
 
     // parses arguments related to skipping directly to a given game state
@@ -2330,17 +3196,29 @@ int main(int argc, char *argv[]) {
 
     load_motd();
 
+    // lets in-game presses be stamped the moment they come in, rather than when the event loop gets to them
+    SDL_AddEventWatch(game_input_watch, NULL);
+
+    // loads levels for level select in the background (see run_level_cache())
+    start_level_cache();
+
     // stores values for the FPS counter
-    static int start_time, frame_time = 0;
+    // these are measured with the high-resolution timer (see timing.cpp), so they aren't rounded to whole milliseconds
+    static double start_time, frame_time = 0;
+    // frame_time_sum/frame_time_squares are used to work out how much the frame time varies over each second
     int fps = 0;
-    int time_passed = 0;
+    double time_passed = 0;
     int frame_count = 0;
+    double frame_time_sum = 0;
+    double frame_time_squares = 0;
+    double frame_time_deviation = 0;
+    int audio_underruns_reported = 0;
 
     bool program_running = true;
 
     // main loop that runs while the game is active
     while (program_running) {
-        start_time = SDL_GetTicks();
+        start_time = get_time_ms();
 
         // disables cursor during fullscreen
         if (fullscreen_toggle || true_fullscreen_toggle) {SDL_SetRelativeMouseMode(SDL_TRUE);} else {SDL_SetRelativeMouseMode(SDL_FALSE);}
@@ -2358,6 +3236,14 @@ int main(int argc, char *argv[]) {
                 }
                 break;
 
+            // render targets lose whatever was drawn on them when this happens, so the shape layer has to be redrawn
+            // if the whole device was reset, every texture's gone, including the shape atlas
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                reset_shape_layer();
+                if (evt.type == SDL_RENDER_DEVICE_RESET) {reset_shape_atlas();}
+                break;
+
             // handles controller connection/disconnection
             case SDL_CONTROLLERDEVICEADDED:
                 if (controller == NULL) {
@@ -2377,7 +3263,6 @@ int main(int argc, char *argv[]) {
             case SDL_CONTROLLERBUTTONDOWN:
                 controller_buttons input_value;
                 bool in_game = false;
-                unsigned int timestamp;
 
                 // this flag slightly changes the controls for keyboard to make them feel better in-game
                 if (current_state == SANDBOX || current_state == GAME) {in_game = true;}
@@ -2385,12 +3270,10 @@ int main(int argc, char *argv[]) {
                 // this converts the button presses to an abstract controller which is then used when handling input
                 // this reduces code complexity by quite a bit and lets us support both controllers and keyboards more easily
                 if (evt.type == SDL_KEYDOWN) {
-                    timestamp = evt.key.timestamp;
                     input_value = keyboard_to_abstract_button(evt.key.keysym.sym, in_game);
                 }
 
                 if (evt.type == SDL_CONTROLLERBUTTONDOWN) {
-                    timestamp = evt.cbutton.timestamp;
                     input_value = gamepad_to_abstract_button(evt.cbutton.button);
                 }
 
@@ -2491,7 +3374,7 @@ int main(int argc, char *argv[]) {
                             case CROSS:
                                 if (check_fade_in_activity()) {
 
-                                    if (json_file == NULL) {
+                                    if (!level_loaded) {
                                         if (level_paths.size() == 0) {
                                             printf("Attempting to re-scan the levels folder...\n");
                                             load_levels();
@@ -2500,12 +3383,15 @@ int main(int argc, char *argv[]) {
                                         }
 
                                         printf("Attempting to reload the current file...\n");
-                                        json_file = parse_level_file(get_level_json_path());
-                                        load_metadata();
+                                        clear_level_cache();
+                                        load_level_select();
 
                                         break;
                                     }
 
+                                    // the selected level is still loading
+                                    if (level_select_pending) {break;}
+
                                     Mix_PlayChannel(0, snd_menu_confirm, 0);
                                     start_level();
                                     transition_state = GAME;
@@ -2522,24 +3408,22 @@ int main(int argc, char *argv[]) {
                                 break;
 
                             case LEFT:
-                                if (json_file == NULL) {break;}
+                                if (!level_loaded) {break;}
                                 if (check_fade_in_activity()) {
                                     Mix_PlayChannel(0, snd_menu_move, 0);
                                     level_index--;
                                     if (level_index < 0) {level_index = level_paths.size() - 1;}
-                                    json_file = parse_level_file(get_level_json_path());
-                                    load_metadata();
+                                    request_level_select();
                                 }
                                 break;
 
                             case RIGHT:
-                                if (json_file == NULL) {break;}
+                                if (!level_loaded) {break;}
                                 if (check_fade_in_activity()) {
                                     Mix_PlayChannel(0, snd_menu_move, 0);
                                     level_index++;
                                     if (level_index >= level_paths.size()) {level_index = 0;}
-                                    json_file = parse_level_file(get_level_json_path());
-                                    load_metadata();
+                                    request_level_select();
                                 }
                                 break;
                         }
@@ -2553,7 +3437,7 @@ int main(int argc, char *argv[]) {
                         if (evt.type == SDL_KEYDOWN && evt.key.repeat != 0) {break;}
 
                         // handles the game over inputs
-                        if (game_over) {
+                        if (render_snapshot.game_over) {
                             switch(input_value) {
                                 case SELECT:
                                 case START:
@@ -2568,69 +3452,11 @@ int main(int argc, char *argv[]) {
                                     fade_out++;
                                     break;
                             }
-                        } else {
+                        } else if (input_value == SELECT) {
                             // level exiting shouldn't be affected by timing windows
-                            int beat_side = check_beat_timing_window(timestamp);
-                            char op = '.';
-
-                            if (input_value != SELECT) {
-                                // 0 means we're NOT within a timing window
-                                if (beat_side == 0) {break;}
-
-                                // this prevents multiple inputs from going through during a single window
-                                if (check_available_sequence(beat_side) == false) {break;}
-                            }
-
-                            switch(input_value) {
-                                case SELECT:
-                                    Mix_PlayChannel(0, snd_menu_back, 0);
-                                    fade_out++;
-                                    break;
-
-                                case UP:
-                                    op = 'U';
-                                    break;
-
-                                case DOWN:
-                                    op = 'D';
-                                    break;
-
-                                case LEFT:
-                                    op = 'L';
-                                    break;
-
-                                case RIGHT:
-                                    op = 'R';
-                                    break;
-
-                                case CIRCLE:
-                                    op = 'Z';
-                                    break;
-
-                                case SQUARE:
-                                    op = 'X';
-                                    break;
-
-                                case TRIANGLE:
-                                    op = 'C';
-                                    break;
-
-                                case CROSS:
-                                    op = 'V';
-                                    break;
-
-                                case LB:
-                                    op = 'A';
-                                    break;
-
-                                case RB:
-                                    op = 'S';
-                                    break;
-                            }
-
-                            set_character_timer(60000/bpm);
-                            active_shape    = modify_current_shape(op, active_shape, true);
-                            player_sequence = modify_sequence(op, beat_side);
+                            // all other in-game inputs are queued up for the simulation thread by game_input_watch()
+                            Mix_PlayChannel(0, snd_menu_back, 0);
+                            fade_out++;
                         }
                         break;
 
@@ -2869,9 +3695,16 @@ int main(int argc, char *argv[]) {
                             if (check_fade_in_activity()) {
                                 Mix_PlayChannel(0, snd_menu_confirm, 0);
 
-                                if (modify_current_option_button() == 1) {
-                                    transition_state = TITLE;
-                                    fade_out++;
+                                switch (modify_current_option_button()) {
+                                    case 1:
+                                        transition_state = TITLE;
+                                        fade_out++;
+                                        break;
+
+                                    case 2:
+                                        transition_state = CALIBRATION;
+                                        fade_out++;
+                                        break;
                                 }
                             }
                             break;
@@ -2932,6 +3765,28 @@ int main(int argc, char *argv[]) {
                         }
                         break;
 
+                    // taps themselves are picked up by game_input_watch()
+                    case CALIBRATION:
+                        switch(input_value) {
+                            case START:
+                                if (check_fade_activity() || !check_calibration_finished()) {break;}
+                                Mix_PlayChannel(0, snd_menu_confirm, 0);
+                                audio_offset = round(get_calibration_offset());
+                                printf("Audio offset set to %i ms.\n", audio_offset);
+                                save_audio_offset();
+                                transition_state = OPTIONS;
+                                fade_out++;
+                                break;
+
+                            case SELECT:
+                                if (check_fade_activity()) {break;}
+                                Mix_PlayChannel(0, snd_menu_back, 0);
+                                transition_state = OPTIONS;
+                                fade_out++;
+                                break;
+                        }
+                        break;
+
                 }
             }
         }
@@ -2958,6 +3813,7 @@ int main(int argc, char *argv[]) {
                     break;
 
                 case GAME:
+                    stop_simulation();
                     load_default_music("menu");
                     break;
 
@@ -2969,11 +3825,18 @@ int main(int argc, char *argv[]) {
                     if (transition_state == TITLE) {load_default_music("menu");}
                     break;
 
+                case CALIBRATION:
+                    calibration_active = false;
+                    stop_click_track();
+                    load_default_music("menu");
+                    break;
+
                 default:
                     break;
             }
 
             // changes the actual state
+            game_states previous_state = current_state;
             current_state = transition_state;
 
             // Runs functions at the start of a state
@@ -2984,10 +3847,10 @@ int main(int argc, char *argv[]) {
 
                 case LEVEL_SELECT:
                     if (level_paths.empty()) {
-                        json_file = NULL;
+                        level_loaded = false;
+                        level_data = level_info();
                     } else {
-                        json_file = parse_level_file(get_level_json_path());
-                        load_metadata();
+                        load_level_select();
                     }
 
                     break;
@@ -3001,8 +3864,7 @@ int main(int argc, char *argv[]) {
                     reset_color_table();
                     reset_shapes();
                     active_shape.type = 0;
-                    json_file[0]["background_effect"] = "wave"; // hack to force loading a specific BGFX; TODO: make the init function take an optional param to do this instead
-                    init_background_effect();
+                    init_background_effect(wave);
                     sandbox_menu_active = false;
                     sandbox_quit_dialog_active = false;
                     sandbox_quit_dialog_selected = false;
@@ -3018,32 +3880,33 @@ int main(int argc, char *argv[]) {
 
                 case OPTIONS:
                     reset_options_menu();
+                    if (previous_state == CALIBRATION) {return_to_audio_options();}
+                    break;
+
+                case CALIBRATION:
+                    printf("Starting audio calibration...\n");
+                    Mix_HaltMusic();
+                    init_calibration();
+                    start_click_track(snd_metronome_big, get_calibration_interval(), MIX_MAX_VOLUME * sfx_volume / 100);
+                    calibration_active = true;
                     break;
 
                 case GAME:
-                    song_over = false;
-                    game_over = false;
                     transition_state = LEVEL_SELECT;
 
-                    // sets up metronome
-                    float one_bar = 60000/bpm;
-
-                    // divides by the number of beats in a bar
-                    // this allows for unusual time signatures
-                    int time_signature_bottom = get_level_time_signature(false);
-                    float bpm_correction = (one_bar*2) / time_signature_bottom;
-
                     // this marks the start of the song, used for calculating how long the song's been playing
                     // this is used as a global timer for background effects
-                    Mix_PlayMusic(music, 0);
-                    song_start_time = SDL_GetTicks();
+                    // all gameplay timing is done on the song clock, which counts up from 0 once the music starts
+                    play_stage_music();
+                    reset_song_clock();
+                    song_start_time = 0;
 
-                    beat_start_time = song_start_time - bpm_correction;
-                    length = bpm_correction;
-                    intro_beat_length = bpm_correction * get_level_intro_delay();
-                    beat_count = 0;
-                    song_beat_position = 0;
+                    // sets up the beat timer, score, etc.
+                    core_start(game, schedule);
+                    intro_beat_length = game.intro_length;
+                    last_visual_beat_count = 0;
 
+                    start_simulation();
                     break;
 
                 break;
@@ -3061,16 +3924,70 @@ int main(int argc, char *argv[]) {
                 break;
 
             case LEVEL_SELECT:
+                update_hot_reload(false);
+                update_level_select();
                 draw_level_select(previous_shapes, frame_time);
                 break;
 
             case GAME:
-                loop(json_file, get_level_intro_delay(), get_level_time_signature(true), get_level_time_signature(false), song_start_time, frame_time);
-                draw_game(beat_count, get_level_intro_delay(), get_level_measure_length(), song_start_time, beat_start_time, SDL_GetTicks(), intro_beat_length, beat_advanced, shape_advanced, active_shape, result_shape, previous_shapes, grid_toggle, hud_toggle, blindfold_toggle, song_over, game_over, frame_time);
+                // gameplay itself runs on the simulation thread; this only draws the latest snapshot of it
+                take_snapshot();
+                update_hot_reload(true);
+
+                if (render_snapshot.combo_triggered) {set_combo_timer(3000);}
+
+                if (render_snapshot.level_finished && check_fade_activity() == false) {
+                    {
+                        std::lock_guard<std::mutex> lock(game_mutex);
+                        save_metadata();
+                        if (game.stalled_steps > 0) {printf("Caught up %i beat(s) over %i stalled tick(s) during this level.\n", game.caught_up_beats, game.stalled_steps);}
+                    }
+
+                    printf("Ending level...\n");
+                    fade_out++;
+                }
+
+                {
+                    // beats are drawn when they're heard rather than when they're processed; see get_visual_beat()
+                    double visual_ticks = get_song_clock() - audio_offset;
+                    int visual_beat_count = render_snapshot.beat_count;
+                    double visual_beat_start_time = render_snapshot.beat_start_time;
+
+                    get_visual_beat(visual_ticks, visual_beat_count, visual_beat_start_time);
+                    bool visual_beat_advanced = (visual_beat_count != last_visual_beat_count);
+                    last_visual_beat_count = visual_beat_count;
+
+                    // the frame refers to render_snapshot's shapes rather than copying them; it's left alone until the next take_snapshot()
+                    game_frame frame;
+                    frame.beat_count = visual_beat_count;
+                    frame.start_offset = schedule.start_offset;
+                    frame.measure_length = schedule.measure_length;
+                    frame.song_start_time = song_start_time;
+                    frame.beat_start_time = visual_beat_start_time;
+                    frame.current_ticks = visual_ticks;
+                    frame.intro_beat_length = intro_beat_length;
+                    frame.beat_advanced = visual_beat_advanced;
+                    frame.shape_advanced = render_snapshot.shape_advanced;
+                    frame.active_shape = render_snapshot.active_shape;
+                    frame.result_shape = render_snapshot.result_shape;
+                    frame.previous_shapes = &render_snapshot.previous_shapes;
+                    frame.life = render_snapshot.life;
+                    frame.score = render_snapshot.score;
+                    frame.grid_toggle = grid_toggle;
+                    frame.hud_toggle = hud_toggle;
+                    frame.blindfold_toggle = blindfold_toggle;
+                    frame.song_over = render_snapshot.song_over;
+                    frame.game_over = render_snapshot.game_over;
+
+                    draw_game(frame, frame_time);
+                }
                 break;
 
             case SANDBOX:
-                draw_sandbox(active_shape, previous_shapes, sandbox_menu_active, sandbox_lock, sandbox_option_selected, sandbox_quit_dialog_active, sandbox_quit_dialog_selected, frame_time);
+                {
+                    sandbox_frame frame = {active_shape, &previous_shapes, sandbox_menu_active, sandbox_lock, sandbox_option_selected, sandbox_quit_dialog_active, sandbox_quit_dialog_selected};
+                    draw_sandbox(frame, frame_time);
+                }
                 break;
 
             case TUTORIAL:
@@ -3082,6 +3999,10 @@ int main(int argc, char *argv[]) {
                 draw_options(frame_time);
                 break;
 
+            case CALIBRATION:
+                draw_calibration(get_song_clock() - audio_offset, frame_time);
+                break;
+
             case EXIT:
                 program_running = false;
                 break;
@@ -3096,31 +4017,46 @@ int main(int argc, char *argv[]) {
                 break;
         }
 
-        draw_fps(fps_toggle, fps, frame_time);
+        draw_fps(fps_toggle, fps, frame_time, frame_time_deviation);
         SDL_RenderPresent(renderer);
 
         // calculates FPS
-        frame_time = SDL_GetTicks() - start_time;
+        frame_time = get_time_ms() - start_time;
 
         // frame capper
         if (!vsync_toggle) {
-            if (frame_time < frame_cap_ms) {
-                int delay_delta = frame_cap_ms - frame_time;
-                SDL_Delay(delay_delta);
-                frame_time += delay_delta;
-            }
+            wait_for_frame(frame_cap_ms);
+            frame_time = get_time_ms() - start_time;
         }
 
         frame_count++;
         time_passed += frame_time;
+        frame_time_sum += frame_time;
+        frame_time_squares += frame_time * frame_time;
 
         if (time_passed >= 1000) {
+            // standard deviation of the frame time (i.e. the square root of its variance) over the last second
+            double mean = frame_time_sum / frame_count;
+            frame_time_deviation = sqrt(fmax(0, frame_time_squares / frame_count - mean * mean));
+
             fps = frame_count;
             frame_count = 0;
+
+            // underruns are checked here so they're only reported once a second at most
+            if (get_audio_underruns() > audio_underruns_reported) {
+                printf("[!] Audio underrun detected (%i so far). If the audio crackles, try a bigger audio buffer.\n", get_audio_underruns());
+                audio_underruns_reported = get_audio_underruns();
+            }
             time_passed = 0;
+            frame_time_sum = 0;
+            frame_time_squares = 0;
         }
     }
 
+    stop_simulation();
+    stop_level_cache();
     kill();
+    close_level_pack(current_pack);
+    stop_watching_level();
     return 0;
 }
@@ -1,13 +1,16 @@
 #pragma once
 
-std::string get_level_background_effect_string();
+struct SDL_RWops;
+
+const std::string& get_level_background_effect_string();
 std::string get_background_tile_path();
 std::string get_character_tile_path();
-std::string get_level_name();
+SDL_RWops* open_level_asset(std::string);
+const std::string& get_level_name();
 std::string get_level_playlist_name();
-std::string get_genre();
-std::string get_level_author();
-std::string get_song_author();
+const std::string& get_genre();
+const std::string& get_level_author();
+const std::string& get_song_author();
 std::string get_motd();
 std::string get_cpu_sequence();
 std::string get_player_sequence();
@@ -36,8 +39,8 @@ void reset_keyboard_binds();
 
 int get_level_bpm();
 int get_bg_color();
-int check_beat_timing_window(unsigned int);
-bool check_json_validity();
+int check_beat_timing_window(double);
+bool check_level_loaded();
 bool get_debug();
 
 int get_life();
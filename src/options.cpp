@@ -36,6 +36,8 @@ using std::vector;
 int music_volume = 75;
 int sfx_volume = 75;
 bool mono_toggle = false;
+int audio_offset = 0;          // in milliseconds; how far behind the song clock the player hears the audio (see calibration.cpp)
+int audio_buffer_size = 2048;  // in sample frames; only applied when the mixer is opened at startup
 int frame_cap = 120;
 bool fps_toggle = false;
 bool fullscreen_toggle = false;
@@ -64,6 +66,9 @@ enum option_id {
     OPT_MUSIC,
     OPT_SFX,
     OPT_TOGGLE_MONO,
+    OPT_AUDIO_OFFSET,
+    OPT_AUDIO_BUFFER,
+    OPT_CALIBRATE,
     OPT_FULLSCREEN,
     OPT_VSYNC,
     OPT_FRAME_CAP,
@@ -145,6 +150,10 @@ vector<option_item> options_audio = {
     {OPT_SFX,           "options.audio.sfx",       "options.audio.sfx.desc"},
     {OPT_TOGGLE_MONO,   "options.audio.speaker",   "options.audio.speaker.desc"},
     {OPT_NONE},
+    {OPT_AUDIO_OFFSET,  "options.audio.offset",    "options.audio.offset.desc"},
+    {OPT_CALIBRATE,     "options.audio.calibrate", "options.audio.calibrate.desc"},
+    {OPT_AUDIO_BUFFER,  "options.audio.buffer",    "options.audio.buffer.desc"},
+    {OPT_NONE},
     option_back
 };
 
@@ -288,6 +297,12 @@ void reset_options_menu() {
     return;
 }
 
+void return_to_audio_options() {
+    // used when coming back from calibration
+    set_option_menu(OPT_SUB_AUDIO);
+    return;
+}
+
 void reset_rebind_flags() {
     current_rebind_index = 0;
     rebinding_keys = false;
@@ -323,6 +338,8 @@ string get_option_value(int index) {
         case OPT_MUSIC: return to_string(music_volume).append("%");
         case OPT_SFX: return to_string(sfx_volume).append("%");
         case OPT_TOGGLE_MONO: return mono_toggle ? get_lang_string("options.audio.speaker.mono") : get_lang_string("options.audio.speaker.stereo");
+        case OPT_AUDIO_OFFSET: return (audio_offset > 0 ? "+" : "") + to_string(audio_offset) + " ms";
+        case OPT_AUDIO_BUFFER: return to_string(audio_buffer_size);
         case OPT_FULLSCREEN: return fullscreen_toggle ? on : off;
         case OPT_VSYNC: return vsync_toggle ? on : off;
         case OPT_FRAME_CAP: return to_string(frame_cap);
@@ -388,6 +405,16 @@ void modify_current_option_directions(int mod_value = 1) {
             set_sfx_volume();
             break;
 
+        case OPT_AUDIO_OFFSET:
+            audio_offset = modify_option_value(audio_offset, mod_value, -500, 500);
+            break;
+
+        case OPT_AUDIO_BUFFER:
+            // buffer sizes go up in powers of 2
+            if (mod_value > 0 && audio_buffer_size < 4096) {audio_buffer_size *= 2;}
+            if (mod_value < 0 && audio_buffer_size > 256) {audio_buffer_size /= 2;}
+            break;
+
         case OPT_FRAME_CAP:
             frame_cap = modify_option_value(frame_cap, mod_value, 30, 1000);
             set_frame_cap_ms();
@@ -406,7 +433,7 @@ void modify_current_option_directions(int mod_value = 1) {
 
 int modify_current_option_button() {
     // this function is what handles how each option can be interacted with via the A button
-    // returns 0 normally, but if 1 is returned the game will return to the menu
+    // returns 0 normally, but if 1 is returned the game will return to the menu, and if 2 is returned it'll go to calibration
     // this strange coding is because of how transition states are scoped to the main() loop, see main.cpp
 
     option_id current_selection = options[option_selected].id;
@@ -622,6 +649,9 @@ int modify_current_option_button() {
             rebinding_single = true;
             break;
 
+        case OPT_CALIBRATE:
+            return 2;
+
         case OPT_SAVE:
             save_settings();
             return 1;
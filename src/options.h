@@ -12,6 +12,7 @@ bool check_rebind_keys();
 bool check_rebind_controller();
 void reset_rebind_flags();
 void reset_options_menu();
+void return_to_audio_options();
 
 void move_option_selection(int);
 void modify_current_option_directions(int);
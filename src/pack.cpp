@@ -0,0 +1,213 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "level.h"
+#include "pack.h"
+
+using std::string;
+using std::vector;
+
+// level packs (.ompack)
+// a pack holds every file from a level folder (level.json, song.ogg, sounds, tiles...), so a level can be shipped and loaded as one file
+// the game maps the whole pack once, and hands each file to SDL straight from the mapping instead of opening them one by one
+// every number is little-endian; the layout goes as follows:
+// ----------------------------------------------------------
+// header: "OMPK", u16 version, u16 reserved (0), u32 file count
+// index: for each file, u32 offset, u32 size, u16 name length, then the name (no terminator)
+// data: each file's contents, starting on a pack_alignment-byte boundary
+
+const char pack_magic[4] = {'O', 'M', 'P', 'K'};
+const int pack_version = 1;
+const int pack_alignment = 16;
+
+void put_pack_number(vector<unsigned char> &out, unsigned long value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((value >> (i * 8)) & 0xFF);
+    }
+
+    return;
+}
+
+unsigned long get_pack_number(const unsigned char *data, int bytes) {
+    unsigned long value = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned long)data[i] << (i * 8);
+    }
+
+    return value;
+}
+
+bool build_level_pack(const string &folder, const string &path) {
+    // packs every file in a level folder (but not its subfolders) into a single pack at path
+    vector<std::filesystem::path> files;
+    std::error_code err;
+
+    for (auto& dir_entry: std::filesystem::directory_iterator{folder, err}) {
+        if (dir_entry.is_regular_file()) {files.push_back(dir_entry.path());}
+    }
+
+    if (err || files.empty()) {
+        printf("[!] Couldn't pack level: %s has no files to pack.\n", folder.c_str());
+        return false;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    vector<unsigned char> index;
+    vector<vector<char>> contents;
+    size_t index_size = 12;
+
+    for (int i = 0; i < files.size(); i++) {
+        index_size += 10 + files[i].filename().string().length();
+    }
+
+    size_t offset = index_size;
+
+    for (int i = 0; i < files.size(); i++) {
+        std::ifstream file(files[i], std::ios::binary);
+        contents.push_back(vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+
+        string name = files[i].filename().string();
+        offset = (offset + pack_alignment - 1) / pack_alignment * pack_alignment;
+
+        if (offset + contents[i].size() > 0xFFFFFFFF || name.length() > 0xFFFF) {
+            printf("[!] Couldn't pack level: %s is too big.\n", files[i].string().c_str());
+            return false;
+        }
+
+        put_pack_number(index, offset, 4);
+        put_pack_number(index, contents[i].size(), 4);
+        put_pack_number(index, name.length(), 2);
+        index.insert(index.end(), name.begin(), name.end());
+
+        offset += contents[i].size();
+    }
+
+    vector<unsigned char> out;
+    out.insert(out.end(), pack_magic, pack_magic + 4);
+    put_pack_number(out, pack_version, 2);
+    put_pack_number(out, 0, 2);
+    put_pack_number(out, files.size(), 4);
+    out.insert(out.end(), index.begin(), index.end());
+
+    for (int i = 0; i < files.size(); i++) {
+        out.resize((out.size() + pack_alignment - 1) / pack_alignment * pack_alignment, 0);
+        out.insert(out.end(), contents[i].begin(), contents[i].end());
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+
+    if (file == NULL) {
+        printf("[!] Couldn't write level pack: %s\n", path.c_str());
+        return false;
+    }
+
+    bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+
+    if (!written) {
+        printf("[!] Couldn't write level pack: %s\n", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+
+    printf("Packed %i file(s) into %s.\n", (int)files.size(), path.c_str());
+    return true;
+}
+
+bool open_level_pack(const string &path, level_pack &pack) {
+    // maps a pack and reads its index; the pack stays mapped until close_level_pack()
+    pack.entries.clear();
+
+    if (!map_level_file(path, pack.file)) {
+        printf("[!] Couldn't map level pack: %s\n", path.c_str());
+        return false;
+    }
+
+    const unsigned char *data = pack.file.data;
+    size_t size = pack.file.size;
+
+    if (size < 12 || memcmp(data, pack_magic, 4) != 0 || get_pack_number(data + 4, 2) != pack_version) {
+        printf("[!] Couldn't read level pack: %s is not a supported level pack.\n", path.c_str());
+        close_level_pack(pack);
+        return false;
+    }
+
+    int count = get_pack_number(data + 8, 4);
+    size_t pos = 12;
+
+    for (int i = 0; i < count; i++) {
+        if (pos + 10 > size) {break;}
+
+        pack_entry entry;
+        entry.offset = get_pack_number(data + pos, 4);
+        entry.size = get_pack_number(data + pos + 4, 4);
+        size_t name_length = get_pack_number(data + pos + 8, 2);
+        pos += 10;
+
+        if (pos + name_length > size || entry.offset > size || entry.size > size - entry.offset) {break;}
+
+        entry.name.assign((const char*) data + pos, name_length);
+        pos += name_length;
+
+        pack.entries.push_back(entry);
+    }
+
+    if (pack.entries.size() != count) {
+        printf("[!] Couldn't read level pack: %s is truncated or corrupt.\n", path.c_str());
+        close_level_pack(pack);
+        return false;
+    }
+
+    return true;
+}
+
+void close_level_pack(level_pack &pack) {
+    unmap_level_file(pack.file);
+    pack.entries.clear();
+    return;
+}
+
+bool find_pack_entry(const level_pack &pack, const string &name, const unsigned char *&data, size_t &size) {
+    // finds a file in an open pack; data points into the mapping, so it's only valid until the pack is closed
+    for (int i = 0; i < pack.entries.size(); i++) {
+        if (pack.entries[i].name != name) {continue;}
+
+        data = pack.file.data + pack.entries[i].offset;
+        size = pack.entries[i].size;
+        return true;
+    }
+
+    return false;
+}
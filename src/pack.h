@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "level.h"
+
+// level packs (.ompack): a whole level folder in a single file; see pack.cpp for the file layout
+
+// a file inside a pack; offset is from the start of the pack
+struct pack_entry {
+    std::string name;
+    size_t offset;
+    size_t size;
+};
+
+// a pack that's been mapped into memory; its files can be read straight out of file.data until it's closed
+struct level_pack {
+    mapped_level file;
+    std::vector<pack_entry> entries;
+};
+
+bool build_level_pack(const std::string&, const std::string&);
+bool open_level_pack(const std::string&, level_pack&);
+void close_level_pack(level_pack&);
+bool find_pack_entry(const level_pack&, const std::string&, const unsigned char*&, size_t&);
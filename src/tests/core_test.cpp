@@ -0,0 +1,366 @@
+// This file is to be compiled on its own in order to test the game core (see core.h).
+// This is separate from the main game; as such, it is not to be included in the list of source files when building.
+// It doesn't need SDL, and runs entirely headless: it plays a small level with perfect inputs and with no inputs, and checks the results.
+// It also reads that level with the streaming parser, and compiles it into a .omlvl file (see level.h), checking that both give the same schedule.
+// It checks packed shape ops and the shape solver's sequences against every shape the player can make.
+// It draws shapes with the software compositor (see compositor.h), including an erased one, and counts the pixels.
+// Lastly, it packs a level folder into a level pack (see pack.h) and reads the files back out of it.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "../core.h"
+#include "../level.h"
+#include "../pack.h"
+#include "../compositor.h"
+
+using json = nlohmann::json;
+
+// a 2/2 level (4 beats per measure, 8 beats of intro) with three shapes
+const json test_level = json::parse(R"([
+    {"bpm": 120, "time_signature_top": 2, "time_signature_bottom": 2},
+    {"shape": 0, "x": 9, "y": 7, "scale": 1, "sequence": "ZRR.", "color": 3},
+    {"shape": 1, "x": 7, "y": 6, "scale": 2, "sequence": "XSU.", "color": 5},
+    {"shape": 2, "x": 6, "y": 8, "scale": 1, "sequence": "CLD.", "color": 7, "auto_shapes": [{"shape": 0, "x": 1, "y": 1, "scale": 1, "color": 2}]}
+])");
+
+int failures = 0;
+
+level_source get_test_source() {
+    // test_level as parse_level_stream() should read it, put together by hand
+    level_source source;
+    source.info.bpm = 120;
+    source.info.time_signature_top = 2;
+    source.info.time_signature_bottom = 2;
+    source.info.measure_length = 4;
+
+    for (int i = 1; i < test_level.size(); i++) {
+        const json &entry = test_level[i];
+        level_shape_entry shape_entry;
+
+        shape_entry.target = {entry["shape"], entry["x"], entry["y"], entry["scale"], entry["color"]};
+        shape_entry.sequence = entry["sequence"];
+        shape_entry.has_sequence = true;
+
+        for (const json &auto_shape: entry.value("auto_shapes", json::array())) {
+            shape_entry.auto_shapes.push_back({auto_shape["shape"], auto_shape["x"], auto_shape["y"], auto_shape["scale"], auto_shape["color"]});
+        }
+
+        source.shapes.push_back(shape_entry);
+    }
+
+    return source;
+}
+
+void check(bool condition, std::string name) {
+    if (condition) {
+        printf("PASS: %s\n", name.c_str());
+    } else {
+        printf("[!] FAIL: %s\n", name.c_str());
+        failures++;
+    }
+
+    return;
+}
+
+std::vector<core_input> get_perfect_inputs(const level_schedule &schedule, double beat_length) {
+    // copies the CPU's sequence for every shape, pressing each op 10ms before the beat it belongs to
+    std::vector<core_input> inputs;
+    int ml = schedule.measure_length;
+
+    for (int s = 0; s < schedule.total_shapes; s++) {
+        for (int j = 0; j < ml; j++) {
+            char op = schedule.cpu_ops[(s + 1) * ml + j];
+            if (op == '.') {continue;}
+
+            int beat = schedule.start_offset + (ml * 2 * s) + ml + j;
+            inputs.push_back({op, beat * beat_length - 10});
+        }
+    }
+
+    return inputs;
+}
+
+int play(core_state &state, const level_schedule &schedule, const std::vector<core_input> &inputs, double step_ms, std::vector<core_event> &events) {
+    // plays the level until it ends, stepping step_ms at a time and handing over each input once it's due; returns the number of steps
+    core_start(state, schedule);
+    events.clear();
+
+    std::vector<core_input> due;
+    int next_input = 0;
+    int steps = 0;
+
+    for (double time = 0; time < 60000; time += step_ms) {
+        due.clear();
+
+        while (next_input < inputs.size() && inputs[next_input].time <= time) {
+            due.push_back(inputs[next_input]);
+            next_input++;
+        }
+
+        core_step(state, schedule, time, due, events);
+        steps++;
+
+        if (state.level_finished || state.game_over) {break;}
+    }
+
+    return steps;
+}
+
+int count_events(const std::vector<core_event> &events, core_event_type type) {
+    int count = 0;
+
+    for (int i = 0; i < events.size(); i++) {
+        if (events[i].type == type) {count++;}
+    }
+
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    level_schedule schedule;
+    compile_level_schedule(get_test_source(), schedule);
+
+    check(schedule.measure_length == 4 && schedule.start_offset == 8 && schedule.total_shapes == 3, "level compiles");
+
+    for (int i = 1; i < test_level.size(); i++) {
+        shape expected = {test_level[i]["shape"], test_level[i]["x"], test_level[i]["y"], test_level[i]["scale"], 0};
+        check(check_sequence_validity(test_level[i]["sequence"], expected), "sequence #" + std::to_string(i) + " is valid");
+    }
+
+    core_state state;
+    std::vector<core_event> events;
+
+    core_start(state, schedule);
+    std::vector<core_input> inputs = get_perfect_inputs(schedule, state.beat_length);
+
+    // perfect play, one step per millisecond (like the game's simulation thread)
+    play(state, schedule, inputs, 1, events);
+
+    check(state.level_finished && !state.game_over, "perfect play finishes the level");
+    check(state.life == 100 && state.combo == 3, "perfect play keeps full life and combo");
+    check(state.score == 150 * 1 + 150 * 2 + 150 * 3, "perfect play scores 900 (got " + std::to_string(state.score) + ")");
+    check(state.previous_shapes.size() == 4, "every shape and auto-shape gets placed");
+    check(count_events(events, CORE_SHAPE_CLEARED) == 3 && count_events(events, CORE_SHAPE_FAILED) == 0, "every shape is cleared");
+    check(count_events(events, CORE_PLAYER_OP) == inputs.size(), "every input lands in a timing window");
+    check(count_events(events, CORE_SONG_OVER) == 1 && count_events(events, CORE_LEVEL_FINISHED) == 1, "level end is only reported once");
+
+    // the same play, but in much coarser steps, should give the exact same result
+    core_state coarse_state;
+    std::vector<core_event> coarse_events;
+    play(coarse_state, schedule, inputs, 250, coarse_events);
+
+    bool same_events = coarse_events.size() == events.size();
+
+    for (int i = 0; same_events && i < events.size(); i++) {
+        same_events = events[i].type == coarse_events[i].type && events[i].op == coarse_events[i].op && events[i].value == coarse_events[i].value;
+    }
+
+    check(same_events && coarse_state.score == state.score, "results don't depend on step size");
+
+    // no inputs at all; every shape fails, so the game should end after 4 of them
+    play(state, schedule, {}, 1, events);
+
+    check(state.game_over && !state.level_finished, "no inputs ends in a game over");
+    check(count_events(events, CORE_SHAPE_FAILED) == 4 && state.life == 0 && state.score == 0, "no inputs fails 4 shapes");
+
+    // pressing outside of the timing windows shouldn't do anything
+    core_start(state, schedule);
+    events.clear();
+    core_step(state, schedule, (schedule.start_offset + schedule.measure_length) * state.beat_length + 250, {{'Z', (schedule.start_offset + schedule.measure_length) * state.beat_length + 250}}, events);
+
+    check(count_events(events, CORE_PLAYER_OP) == 0 && state.player_sequence == "....", "off-beat inputs are ignored");
+
+    // with an audio offset, a press can be stamped a little before a beat the core has already processed
+    // it should still be judged against that beat, but only if it's within the window
+    core_input early_press = inputs[0];
+    double after_beat = early_press.time + 20;
+
+    core_start(state, schedule);
+    events.clear();
+    core_step(state, schedule, after_beat, {}, events);
+    core_step(state, schedule, after_beat, {early_press}, events);
+    check(count_events(events, CORE_PLAYER_OP) == 1, "an early press judged after its beat still counts");
+
+    early_press.time -= 90;
+    core_start(state, schedule);
+    events.clear();
+    core_step(state, schedule, after_beat, {}, events);
+    core_step(state, schedule, after_beat, {early_press}, events);
+    check(count_events(events, CORE_PLAYER_OP) == 0, "a press too early for a beat that's already passed is ignored");
+
+    // packed ops should do exactly what apply_shape_op() does, for every shape and every op
+    // that includes bytes past ASCII (e.g. UTF-8 in a level's sequence), which do nothing even where they'd mask to a real op
+    bool packed_match = true;
+    const char all_ops[] = "ZXCVASUDLR.?\xDA\xD3";
+
+    for (int state = 0; packed_match && state < shape_state_count; state++) {
+        for (int i = 0; packed_match && all_ops[i] != 0; i++) {
+            packed_match = apply_packed_op(all_ops[i], state) == get_shape_state(apply_shape_op(all_ops[i], get_state_shape(state)));
+        }
+    }
+
+    check(packed_match, "packed ops match apply_shape_op()");
+
+    // every visible shape is as many ops away as its distance from where new shapes appear (the shape op, then scale, x and y one at a time)
+    bool solved = get_shape_distance({-1, 7, 7, 1, 0}) == 0;
+
+    for (int state = 1; solved && state < shape_state_count; state++) {
+        int type = (state - 1) / (15 * 15 * 8);
+        int scale = (state - 1) / (15 * 15) % 8 + 1;
+        int y = (state - 1) / 15 % 15;
+        int x = (state - 1) % 15;
+        shape target = {type, x, y, scale, 0};
+        std::string sequence = solve_shape_sequence(target);
+
+        solved = get_shape_state(target) == state && get_shape_distance(target) == 1 + (scale - 1) + abs(x - 7) + abs(y - 7);
+        solved = solved && sequence.length() == get_shape_distance(target) && check_sequence_validity(sequence, target);
+    }
+
+    check(solved, "solver finds a shortest sequence for every shape");
+    check(solve_shape_sequence({0, 9, 5, 3, 0}) == "ZSSRRUU", "solver prefers shape, scale, horizontal, then vertical ops");
+    check(get_shape_distance({0, 15, 7, 1, 0}) == -1 && get_shape_distance({3, 7, 7, 1, 0}) == -1 && get_shape_distance({-1, 3, 7, 1, 0}) == -1, "solver rejects shapes that can't be made");
+
+    // a square covering the whole canvas, with a triangle erased out of it; the triangle's rows are 0 to 49 pixels wide, so every span width gets filled
+    shape_canvas canvas;
+    const unsigned char red[4] = {255, 0, 0, 255};
+    const unsigned char erase[4] = {0, 0, 0, 0};
+    int red_pixels = 0;
+    int erased_pixels = 0;
+
+    resize_shape_canvas(canvas, 150);
+    fill_canvas_shape(canvas, {1, 7, 7, 8, 0}, red, 10);
+    fill_canvas_shape(canvas, {2, 7, 7, 3, 0}, erase, 10);
+
+    for (uint32_t pixel: canvas.pixels) {
+        if (pixel == get_canvas_pixel(red)) {red_pixels++;}
+        if (pixel == get_canvas_pixel(erase)) {erased_pixels++;}
+    }
+
+    check(erased_pixels == 50 * 49 / 2 && red_pixels + erased_pixels == 150 * 150, std::string("compositor fills and erases shapes exactly (") + get_span_fill_name() + ")");
+
+    mark_shape_canvas_clean(canvas);
+    fill_canvas_shape(canvas, {1, 7, 7, 1, 0}, red, 10);
+    check(canvas.dirty_top == 70 && canvas.dirty_bottom == 80 && canvas.pixels[75 * 150 + 70] == get_canvas_pixel(red), "compositor only marks the rows it drew on");
+
+    // reads the level with the streaming parser; the schedule should match the one made from the level put together by hand
+    std::istringstream stream(test_level.dump());
+    level_source source;
+    level_schedule source_schedule;
+    std::string error;
+
+    bool streamed = parse_level_stream(stream, source, error);
+    if (streamed) {compile_level_schedule(source, source_schedule);}
+
+    check(streamed && source.shapes.size() == 3 && source.shapes[2].auto_shapes.size() == 1, "streamed level has every shape (" + error + ")");
+    check(streamed && source_schedule.cpu_ops == schedule.cpu_ops && source_schedule.auto_shape_start == schedule.auto_shape_start && source_schedule.start_offset == schedule.start_offset, "streamed schedule matches");
+
+    std::istringstream bad_stream("[{\"bpm\": 120}, {\"shape\": ]");
+    check(!parse_level_stream(bad_stream, source, error), "malformed level is rejected");
+
+    // anything nested in the color table counts as a single malformed color, so the ones after it keep their index
+    std::istringstream color_stream("[{\"bpm\": 120, \"color_table\": [\"#112233\", [\"#445566\", \"#778899\"], {\"a\": 1}, \"#AABBCC\"]}]");
+    level_source color_source;
+    bool colors_read = parse_level_stream(color_stream, color_source, error);
+    check(colors_read && color_source.color_table_set[1] && color_source.color_table[1].empty() && color_source.color_table[2].empty() && color_source.color_table[3] == "#AABBCC" && !color_source.color_table_set[4], "nested values in the color table count as one color each");
+
+    // compiles the level, then reads it back; the schedule should match the one made from the JSON
+    unsigned char palette[16][4];
+    unsigned char read_palette[16][4];
+
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 4; j++) {palette[i][j] = i * 16 + j;}
+    }
+
+    std::istringstream compiled_stream(test_level.dump());
+    level_source compiled_level;
+    parse_level_stream(compiled_stream, compiled_level, error);
+    compiled_level.info.name = "Core Test";
+
+    const char *compiled_path = "core_test.omlvl";
+    mapped_level mapped;
+    level_info info;
+    std::vector<shape> preview_shapes;
+    level_schedule read_schedule;
+
+    bool compiled = compile_level_file(compiled_level, palette, compiled_path) && map_level_file(compiled_path, mapped);
+    bool read = compiled && read_level_file(mapped, info, preview_shapes, read_palette, read_schedule);
+    std::vector<unsigned char> damaged_bytes;
+
+    if (compiled) {
+        damaged_bytes.assign(mapped.data, mapped.data + mapped.size);
+        unmap_level_file(mapped);
+    }
+    remove(compiled_path);
+
+    check(read, "compiled level can be read back");
+    check(read && read_schedule.cpu_ops == schedule.cpu_ops && read_schedule.colors == schedule.colors && read_schedule.song_steps == schedule.song_steps, "compiled sequences match");
+    check(read && read_schedule.start_offset == schedule.start_offset && read_schedule.auto_shape_start == schedule.auto_shape_start && read_schedule.auto_shapes.size() == schedule.auto_shapes.size() && read_schedule.beat_flags == schedule.beat_flags, "compiled schedule matches");
+    check(read && preview_shapes.size() == 4 && memcmp(palette, read_palette, sizeof(palette)) == 0, "compiled shapes and palette match");
+    check(read && info.name == "Core Test" && info.bpm == 120 && info.measure_length == 4 && info.genre == "Unknown", "compiled metadata matches");
+
+    // values a compiled level could never have been written with are rejected when reading it, the same as when compiling
+    // the header is 15 bytes and the palette 64, then the first shape follows the five metadata strings
+    level_schedule damaged_schedule;
+    mapped_level damaged = {damaged_bytes.data(), damaged_bytes.size()};
+    size_t first_shape = 79;
+
+    for (int i = 0; i < 5 && compiled; i++) {first_shape = std::find(damaged_bytes.begin() + first_shape, damaged_bytes.end(), 0) - damaged_bytes.begin() + 1;}
+
+    unsigned char first_x = compiled ? damaged_bytes[first_shape + 1] : 0;
+    if (compiled) {damaged_bytes[first_shape + 1] = 15;}
+    check(compiled && !read_level_file(damaged, info, preview_shapes, read_palette, damaged_schedule), "compiled level with a shape off the grid is rejected");
+
+    if (compiled) {damaged_bytes[first_shape + 1] = first_x; damaged_bytes[12] = 17;}
+    check(compiled && !read_level_file(damaged, info, preview_shapes, read_palette, damaged_schedule), "compiled level with a bad bg_color is rejected");
+
+    // packs a small level folder, then reads each file back out of the pack
+    const char *pack_folder = "core_test_level";
+    const char *pack_path = "core_test_level.ompack";
+    std::string level_text = test_level.dump();
+    std::string song_text(1000, 'S');
+
+    std::filesystem::create_directory(pack_folder);
+    std::ofstream(std::string(pack_folder) + "/level.json", std::ios::binary) << level_text;
+    std::ofstream(std::string(pack_folder) + "/song.ogg", std::ios::binary) << song_text;
+
+    level_pack pack;
+    const unsigned char *pack_data;
+    size_t pack_size;
+
+    bool packed = build_level_pack(pack_folder, pack_path) && open_level_pack(pack_path, pack);
+    check(packed && pack.entries.size() == 2, "level folder can be packed");
+
+    bool found_level = packed && find_pack_entry(pack, "level.json", pack_data, pack_size);
+    check(found_level && std::string((const char*) pack_data, pack_size) == level_text, "packed level.json matches");
+
+    level_source packed_level;
+    level_schedule packed_schedule;
+    bool parsed_pack = found_level && parse_level_data(pack_data, pack_size, packed_level, error);
+    if (parsed_pack) {compile_level_schedule(packed_level, packed_schedule);}
+    check(parsed_pack && packed_schedule.cpu_ops == schedule.cpu_ops, "packed level parses in place");
+
+    bool found_song = packed && find_pack_entry(pack, "song.ogg", pack_data, pack_size);
+    check(found_song && std::string((const char*) pack_data, pack_size) == song_text && (pack_data - pack.file.data) % 16 == 0, "packed song matches and is aligned");
+    check(packed && !find_pack_entry(pack, "tile.png", pack_data, pack_size), "missing files aren't found in a pack");
+
+    if (packed) {close_level_pack(pack);}
+    std::filesystem::remove_all(pack_folder);
+    remove(pack_path);
+
+    if (failures > 0) {
+        printf("[!] %i check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed.\n");
+    return 0;
+}
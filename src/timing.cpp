@@ -0,0 +1,253 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <atomic>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+
+// high-resolution timebase, built on the performance counter
+// all times are in milliseconds (as doubles, so sub-millisecond precision is kept)
+Uint64 timer_start_counter = 0;
+double timer_counter_ms = 1000.0;
+
+// frame pacer; see wait_for_frame()
+// frames are scheduled against an absolute deadline so sleep overshoot doesn't add up over time
+// the last frame_spin_ms of every wait is spent spinning, since SDL_Delay() can overshoot by a millisecond or two
+double next_frame_time = 0;
+const double frame_spin_ms = 2.0;
+
+// the song clock is driven by how many audio frames the mixer has handed to the audio device
+// this keeps gameplay locked to what's actually being heard, unlike SDL_GetTicks() which drifts
+// ----------------------------------------------------------
+// mixed_frames: total frames mixed, including the buffer that's currently playing
+// played_frames: frames mixed *before* the current buffer (i.e. the start of what's audible now)
+// mix_counter: performance counter value when the current buffer was handed over
+// mix_sequence: odd while the audio thread is writing, lets the main thread read without locking
+std::atomic<Uint64> mixed_frames{0};
+std::atomic<Uint64> played_frames{0};
+std::atomic<Uint64> mix_counter{0};
+std::atomic<Uint32> mix_sequence{0};
+
+int audio_frequency = 44100;
+int audio_frame_size = 4;
+SDL_AudioFormat audio_format = AUDIO_S16SYS;
+
+// frame count when the clock was reset (i.e. when the song started)
+// atomic since the audio thread reads it for the click track
+std::atomic<Uint64> song_clock_start{0};
+
+// underrun detection; a buffer that gets mixed much later than the last one finished playing means the device ran dry
+// underrun_threshold is how late a buffer can be (in multiples of its own length) before it counts
+std::atomic<int> audio_underruns{0};
+const double underrun_threshold = 2.0;
+
+// click track used for calibration; see start_click_track()
+// the clicks are mixed straight into the output, so each one lands exactly on the song clock like the song itself would
+// click_interval_frames is 0 whenever the click track is off
+std::atomic<Mix_Chunk*> click_chunk{NULL};
+std::atomic<Uint64> click_interval_frames{0};
+std::atomic<int> click_volume{MIX_MAX_VOLUME};
+
+// used to make sure the clock never runs backwards between two calls
+// atomic since both the simulation and render threads read the clock
+std::atomic<double> last_song_clock{0};
+
+void init_timer() {
+    // starts the high-resolution timebase; should be called right after SDL_Init()
+    timer_counter_ms = 1000.0 / SDL_GetPerformanceFrequency();
+    timer_start_counter = SDL_GetPerformanceCounter();
+    return;
+}
+
+double get_time_ms() {
+    // returns milliseconds since init_timer() was called
+    return (SDL_GetPerformanceCounter() - timer_start_counter) * timer_counter_ms;
+}
+
+void wait_for_frame(double period) {
+    // waits until the next frame is due, so frames end up exactly period milliseconds apart on average
+    // events are pumped while waiting, so in-game presses still get stamped as soon as they happen
+    double now = get_time_ms();
+    next_frame_time += period;
+
+    // if we've fallen more than a frame behind (or the frame cap was changed), start over rather than rushing to catch up
+    if (next_frame_time < now - period || next_frame_time > now + period) {
+        next_frame_time = now + period;
+    }
+
+    while (next_frame_time - get_time_ms() > frame_spin_ms) {
+        SDL_PumpEvents();
+        SDL_Delay(1);
+    }
+
+    while (get_time_ms() < next_frame_time) {
+        SDL_PumpEvents();
+    }
+
+    return;
+}
+
+void mix_click_track(Uint8 *stream, int len, Uint64 frames) {
+    // mixes every click that overlaps the buffer being mixed; called from song_clock_postmix()
+    // frames: total frames mixed before this buffer
+    Uint64 interval = click_interval_frames.load();
+    Mix_Chunk *chunk = click_chunk.load();
+    Uint64 clock_start = song_clock_start.load();
+
+    if (interval == 0 || chunk == NULL || frames < clock_start) {return;}
+
+    Uint64 start = frames - clock_start;
+    Uint64 end = start + (len / audio_frame_size);
+    Uint64 click_length = chunk->alen / audio_frame_size;
+
+    // the first click that could still be sounding at the start of the buffer
+    Uint64 click = (start >= click_length) ? (start - click_length) / interval + 1 : 0;
+
+    for (; click * interval < end; click++) {
+        Uint64 click_start = click * interval;
+        Uint64 from = (click_start > start) ? click_start : start;
+        Uint64 to = (click_start + click_length < end) ? click_start + click_length : end;
+
+        if (to <= from) {continue;}
+
+        SDL_MixAudioFormat(stream + (from - start) * audio_frame_size, chunk->abuf + (from - click_start) * audio_frame_size, audio_format, (to - from) * audio_frame_size, click_volume);
+    }
+
+    return;
+}
+
+void song_clock_postmix(void *udata, Uint8 *stream, int len) {
+    // post-mix callback, runs on the audio thread every time a buffer is mixed
+    Uint64 frames = mixed_frames.load();
+    Uint64 counter = SDL_GetPerformanceCounter();
+
+    // checks whether this buffer came late, i.e. the last one had already finished playing for a while
+    if (frames > 0) {
+        double buffer_ms = (frames - played_frames.load()) * 1000.0 / audio_frequency;
+        double gap_ms = (counter - mix_counter.load()) * timer_counter_ms;
+
+        if (gap_ms > buffer_ms * underrun_threshold) {audio_underruns++;}
+    }
+
+    mix_click_track(stream, len, frames);
+
+    mix_sequence++;
+    played_frames = frames;
+    mixed_frames = frames + (len / audio_frame_size);
+    mix_counter = counter;
+    mix_sequence++;
+
+    return;
+}
+
+void init_song_clock() {
+    // reads the audio device's format and hooks the post-mix callback
+    // must be called after Mix_OpenAudio()
+    Uint16 format;
+    int channels;
+
+    if (Mix_QuerySpec(&audio_frequency, &format, &channels) == 0) {
+        printf("[!] Couldn't query audio format: %s\n", Mix_GetError());
+        return;
+    }
+
+    audio_format = format;
+    audio_frame_size = channels * (SDL_AUDIO_BITSIZE(format) / 8);
+    Mix_SetPostMix(song_clock_postmix, NULL);
+
+    printf("Song clock running at %i Hz.\n", audio_frequency);
+    return;
+}
+
+void reset_song_clock() {
+    // sets the song clock back to 0; call this right after starting the song
+    song_clock_start = mixed_frames.load();
+    last_song_clock = 0;
+    return;
+}
+
+double get_song_clock() {
+    // returns how long the song has been playing in milliseconds, according to the audio device
+    // the time since the last mix callback is added on top, since callbacks only happen once per buffer
+    Uint64 played, mixed, counter;
+    Uint64 clock_start = song_clock_start.load();
+    Uint32 sequence;
+
+    do {
+        sequence = mix_sequence.load();
+        played = played_frames.load();
+        mixed = mixed_frames.load();
+        counter = mix_counter.load();
+    } while ((sequence & 1) || sequence != mix_sequence.load());
+
+    // nothing has been mixed since the reset yet
+    if (mixed <= clock_start) {return last_song_clock;}
+    if (played < clock_start) {played = clock_start;}
+
+    double buffer_ms = (mixed - played) * 1000.0 / audio_frequency;
+    double elapsed_ms = (SDL_GetPerformanceCounter() - counter) * timer_counter_ms;
+    if (elapsed_ms > buffer_ms) {elapsed_ms = buffer_ms;}
+
+    double clock = (played - clock_start) * 1000.0 / audio_frequency + elapsed_ms;
+
+    // only ever moves the clock forwards, even if another thread got a later reading in the meantime
+    double last = last_song_clock.load();
+
+    while (clock > last) {
+        if (last_song_clock.compare_exchange_weak(last, clock)) {return clock;}
+    }
+
+    return last;
+}
+
+double convert_time_to_song_clock(double time) {
+    // converts a time from get_time_ms() (e.g. an input event) to the song clock
+    double clock = get_song_clock() - (get_time_ms() - time);
+    if (clock < 0) {clock = 0;}
+
+    return clock;
+}
+
+void start_click_track(Mix_Chunk *chunk, double interval, int volume) {
+    // starts playing chunk every interval milliseconds, and resets the song clock so the first click is at 0
+    // chunk should already be in the device's format, which anything loaded through Mix_LoadWAV() is
+    click_interval_frames = 0;
+    click_chunk = chunk;
+    click_volume = volume;
+    reset_song_clock();
+    click_interval_frames = (Uint64)(interval * audio_frequency / 1000.0);
+    return;
+}
+
+void stop_click_track() {
+    click_interval_frames = 0;
+    return;
+}
+
+int get_audio_underruns() {
+    // returns how many underruns have been detected since the mixer was opened
+    return audio_underruns;
+}
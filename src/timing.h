@@ -0,0 +1,17 @@
+#pragma once
+
+// defined by SDL_mixer; declared here so this header can be included without it
+struct Mix_Chunk;
+
+void init_timer();
+double get_time_ms();
+void wait_for_frame(double);
+
+void init_song_clock();
+void reset_song_clock();
+double get_song_clock();
+double convert_time_to_song_clock(double);
+
+void start_click_track(Mix_Chunk*, double, int);
+void stop_click_track();
+int get_audio_underruns();
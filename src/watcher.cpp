@@ -0,0 +1,137 @@
+/*  Open Manifold source file
+*
+*   This program/source code is licensed under the MIT License:
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+using std::vector;
+
+// level file watching, used for hot reloading (see update_hot_reload() in main.cpp)
+// one level folder is watched at a time, and every file that's written to (or moved into) it is reported by poll_level_changes()
+// this uses inotify, so it only works on Linux; elsewhere, nothing is ever reported
+// ----------------------------------------------------------
+// watched_folder: the folder being watched (or that failed to be), so the same folder isn't set up again every frame
+// watch_fd: the inotify instance, -1 if there isn't one
+// watch_descriptor: the watch on watched_folder, -1 if there isn't one; events for older watches are ignored
+string watched_folder;
+
+#ifdef __linux__
+int watch_fd = -1;
+int watch_descriptor = -1;
+#endif
+
+void stop_watching_level() {
+    // stops watching the current folder, if there is one
+    watched_folder.clear();
+
+#ifdef __linux__
+    if (watch_fd != -1) {
+        close(watch_fd);
+        watch_fd = -1;
+        watch_descriptor = -1;
+    }
+#endif
+
+    return;
+}
+
+bool watch_level_folder(const string &folder) {
+    // starts watching a level folder, replacing the last one; returns false if it can't be watched
+    // ----------------------------------------------------------
+    // folder: a path to a level folder, e.g. "assets/levels/foobar"
+
+    if (folder == watched_folder) {
+#ifdef __linux__
+        return watch_descriptor != -1;
+#else
+        return false;
+#endif
+    }
+
+    watched_folder = folder;
+
+#ifdef __linux__
+    if (watch_fd == -1) {watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);}
+
+    if (watch_fd == -1) {
+        printf("[!] Couldn't start watching level files: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (watch_descriptor != -1) {inotify_rm_watch(watch_fd, watch_descriptor);}
+    watch_descriptor = inotify_add_watch(watch_fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (watch_descriptor == -1) {
+        printf("[!] Couldn't watch level folder %s: %s\n", folder.c_str(), strerror(errno));
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool poll_level_changes(vector<string> &changed) {
+    // adds the name of every file in the watched folder that's changed since the last call to changed (once each, e.g. "tile.png")
+    // never waits; returns true if anything changed
+
+    bool found = false;
+
+#ifdef __linux__
+    if (watch_fd == -1) {return false;}
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+
+    while ((length = read(watch_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *i = buffer; i < buffer + length; i += sizeof(inotify_event) + ((inotify_event*) i)->len) {
+            const inotify_event *event = (const inotify_event*) i;
+
+            if (event->wd != watch_descriptor || event->len == 0 || (event->mask & IN_ISDIR)) {continue;}
+
+            string name = event->name;
+            bool duplicate = false;
+
+            for (int j = 0; j < changed.size(); j++) {
+                if (changed[j] == name) {duplicate = true;}
+            }
+
+            if (!duplicate) {changed.push_back(name);}
+            found = true;
+        }
+    }
+#endif
+
+    return found;
+}
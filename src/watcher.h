@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+bool watch_level_folder(const std::string&);
+void stop_watching_level();
+bool poll_level_changes(std::vector<std::string>&);